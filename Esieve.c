@@ -1,6 +1,19 @@
+/*
+ * Requires C11 (atomics) and POSIX threads
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* included for testing */
 #include <limits.h>
@@ -9,34 +22,349 @@
 #define BYTEBITS 8  /* if CHAR_BIT > 8 then bits are 'wasted'. Oh well. */
 #define BYTEMASK (BYTEBITS - 1)
 
+/* The odd-only bit arrays are handled as 64-bit words in host byte order:
+ * bit b is bit b % WORDBITS of word b / WORDBITS, and arrays are allocated
+ * in whole words.
+ */
+#define WORDBITS 64
+#define WORDMASK (WORDBITS - 1)
+typedef uint64_t sieveword;
+
+/* Multiples of the odd primes up to PRESIEVEMAX are stamped from a periodic
+ * pattern instead of being crossed off. The pattern repeats every
+ * 3 * 5 * 7 * 11 * 13 bits, so PRESIEVEWORDS words is a whole number of
+ * periods.
+ */
+#define PRESIEVEMAX 13
+#define PRESIEVEWORDS 15015
+
 #define SIEVELIMIT 50000000
 
+/* Segment size for the segmented sieve. A segment should fit in the L1 data
+ * cache (or at least L2); each covers SEGBYTES * 16 integers.
+ */
+#ifndef SEGBYTES
+#define SEGBYTES 32768
+#endif
+#define SEGBITS ((unsigned long)SEGBYTES * BYTEBITS)
+#define SEGSPAN (SEGBITS * 2)
+
+/* Base primes of at least SEGBITS hit a segment at most once, so the
+ * segmented sieve keeps them in buckets: one list per upcoming segment of
+ * the primes whose next multiple falls in it. The lists are chains of
+ * blocks of BUCKETENTS entries.
+ */
+#define BUCKETENTS 1023
+
+struct bucketent {
+    uint32_t prime;
+    uint32_t bit;           /* Offset of the next multiple in its segment */
+};
+
+struct bucketblk {
+    struct bucketblk *next;
+    unsigned long n;
+    struct bucketent e[BUCKETENTS];
+};
+
+/* Sieve cache files: a 64-byte header followed by the sieve array as it is
+ * in memory. The byte order field lets a reader on another host reject
+ * (word-based) arrays it would misread.
+ */
+#define SIEVEMAGIC "ESIEVE\0\0"
+#define SIEVEVERSION 1
+#define SIEVEBYTEORDER 0x01020304UL
+
+#define SIEVE_ODD 1         /* gensieve()/gensieve_mt() odd-only bit array */
+#define SIEVE_WHEEL30 2     /* gensieve30() mod-30 wheel */
+
+struct sievehdr {
+    char magic[8];          /* SIEVEMAGIC */
+    uint32_t version;       /* SIEVEVERSION */
+    uint32_t layout;        /* SIEVE_ODD or SIEVE_WHEEL30 */
+    uint32_t byteorder;     /* SIEVEBYTEORDER as stored by the writer */
+    uint32_t reserved;
+    uint64_t limit;         /* The sieve covers [0, limit) */
+    uint64_t size;          /* Bytes of sieve data following the header */
+    uint64_t checksum;      /* 64-bit FNV-1a of the sieve data */
+    unsigned char pad[16];  /* Keeps the data word aligned */
+};
+
+/* A sieve mapped from a cache file by mapsieve() */
+struct sievemap {
+    const unsigned char *sieve; /* For checkprime(), countprimes() etc */
+    unsigned long limit;
+    int layout;
+    void *base;
+    size_t len;
+};
+
+/* Rank/select index over an odd-only sieve. Clear bits (the primes, plus
+ * the number 1) are counted before every RANKSUPERBITS bits in 'super' and
+ * before every RANKBLOCKBITS bits, relative to the superblock, in 'block':
+ * about 3% on top of the sieve. 'sample' holds the block containing every
+ * SELECTSAMPLE-th clear bit so select needs only a short search.
+ */
+#define RANKBLOCKBITS 512
+#define RANKSUPERBITS 65536
+#define SELECTSAMPLE 8192
+
+struct sieveindex {
+    const unsigned char *sieve;
+    unsigned long limit;
+    unsigned long nbits;    /* Bits in use: odd numbers below limit */
+    unsigned long nprimes;  /* Primes below limit */
+    unsigned long *super;
+    uint16_t *block;
+    unsigned long *sample;
+};
+
+/* A sieve that grows on demand. It is stored as chunks of GROWCHUNKBYTES
+ * (each in the segment layout, starting at a multiple of GROWCHUNKSPAN)
+ * listed in a fixed directory, so existing chunks never move and readers
+ * need no lock. 'limit' is published only after the chunks below it are
+ * complete; extensions are serialised by 'lock'.
+ */
+#define GROWCHUNKBYTES (1UL << 20)
+#define GROWCHUNKSPAN (GROWCHUNKBYTES * BYTEBITS * 2)
+#define GROWMAXCHUNKS 65536     /* Up to about 1.1e12 */
+
+struct growsieve {
+    atomic_ulong limit;     /* Everything below is sieved */
+    pthread_mutex_t lock;
+    unsigned long nchunks;  /* Under 'lock' */
+    sieveword *chunks[GROWMAXCHUNKS];
+};
+
+struct segsieve {
+    unsigned long *primes;  /* Odd base primes up to sqrt(limit) */
+    unsigned long *next;    /* Bit index (n / 2) of each prime's next odd multiple */
+    unsigned long nprimes;
+    unsigned long lo;       /* Start of the next segment (even) */
+    unsigned long limit;
+
+    unsigned long nsmall;   /* primes[0 .. nsmall) are crossed off directly */
+    unsigned long nadded;   /* primes[nsmall .. nadded) are in the buckets */
+    struct bucketblk **buckets;     /* Used circularly, one per segment */
+    unsigned long nbuckets;
+    unsigned long segno;    /* Bucket of the next segment */
+    struct bucketblk *freeblks;
+    struct bucketblk *blkpool;
+
+    sieveword seg[SEGBYTES / sizeof(sieveword)];
+};
+
 unsigned char *gensieve(unsigned long limit);
 unsigned char checkprime(const unsigned char *sieve, unsigned long n);
 
+void presieve(sieveword *words, unsigned long bitlo, unsigned long nwords);
+
+unsigned long *baseprimes(unsigned long limit, unsigned long *count);
+void segstart(const unsigned long *primes, unsigned long nprimes,
+              unsigned long *next, unsigned long lo);
+void sieveseg(unsigned char *seg, unsigned long lo, unsigned long hi,
+              const unsigned long *primes, unsigned long nprimes,
+              unsigned long *next);
+int segsieve_init(struct segsieve *s, unsigned long lo, unsigned long limit);
+const unsigned char *segsieve_next(struct segsieve *s, unsigned long *lo,
+                                   unsigned long *hi);
+void segsieve_free(struct segsieve *s);
+unsigned char checkprimeseg(const unsigned char *seg, unsigned long lo,
+                            unsigned long n);
+
+unsigned char *gensieve_mt(unsigned long limit, int nthreads);
+
+unsigned char *gensieve30(unsigned long limit);
+unsigned char checkprime30(const unsigned char *sieve, unsigned long n);
+
+unsigned long countprimes(const unsigned char *sieve, unsigned long lo,
+                          unsigned long hi);
+unsigned long countprimesseg(const unsigned char *seg, unsigned long lo,
+                             unsigned long hi);
+unsigned long nextprime(const unsigned char *sieve, unsigned long limit,
+                        unsigned long n);
+
+int sieveindex_init(struct sieveindex *ix, const unsigned char *sieve,
+                    unsigned long limit);
+void sieveindex_free(struct sieveindex *ix);
+unsigned long primepi(const struct sieveindex *ix, unsigned long n);
+unsigned long nthprime(const struct sieveindex *ix, unsigned long k);
+
+struct growsieve *growsieve_new(void);
+void growsieve_dispose(struct growsieve *g);
+int growsieve_extend(struct growsieve *g, unsigned long limit);
+unsigned long growsieve_limit(struct growsieve *g);
+int growsieve_checkprime(struct growsieve *g, unsigned long n);
+
+void checkprimes(const unsigned char *sieve, unsigned long limit,
+                 const uint64_t *nums, size_t n, unsigned char *out);
+
+unsigned char *rangesieve(unsigned long a, unsigned long b);
+unsigned long *rangeprimes(unsigned long a, unsigned long b,
+                           unsigned long *count);
+
+unsigned long sievesize(unsigned long limit, int layout);
+int savesieve(const char *path, const unsigned char *sieve,
+              unsigned long limit, int layout);
+int mapsieve(struct sievemap *m, const char *path, int verify);
+void unmapsieve(struct sievemap *m);
+
 unsigned long ceilpow2(unsigned long n, unsigned long base2multiple);
-void setbit(void *addr, unsigned long b);
-void clrbit(void *addr, unsigned long b);
-unsigned char isbitset(const void *addr, unsigned long b);
+inline static void setbit(void *addr, unsigned long b);
+inline static void clrbit(void *addr, unsigned long b);
+inline static unsigned char isbitset(const void *addr, unsigned long b);
 
-int main(void)
+int main(int argc, char *argv[])
 {
-    unsigned long i, count;
+    unsigned long i, count, limit, lo, hi;
     unsigned char *sieve;
+    const unsigned char *seg;
+    struct segsieve *ss;
+    struct sievemap sm;
+    struct sieveindex ix;
+    struct growsieve *gs;
     
-    sieve = gensieve(SIEVELIMIT);
-    
-    if (sieve) {
-        count = 0;
-        for (i = 0; i < SIEVELIMIT; i++)
-            if (checkprime(sieve, i)) {
-                count++;
-                //printf("%lu (#%lu)\n", i, count, i);
+    /* Esieve --range A B: count the primes in [A, B] only */
+    if (argc > 3 && !strcmp(argv[1], "--range")) {
+        unsigned long *primes, a = strtoul(argv[2], NULL, 0);
+
+        if ((primes = rangeprimes(a, strtoul(argv[3], NULL, 0), &count))
+                == NULL) {
+            fputs("Out of memory\n", stderr);
+            return EXIT_FAILURE;
+        }
+        if (count)
+            printf("First %lu, last %lu\n", primes[0], primes[count - 1]);
+        printf("Counted %lu (range)\n", count);
+        free(primes);
+        return 0;
+    }
+
+    limit = argc > 1 ? strtoul(argv[1], NULL, 0) : SIEVELIMIT;
+
+    /* With a cache file, use (or create) it and stop there */
+    if (argc > 2) {
+        int mapped = mapsieve(&sm, argv[2], 0) == 0;
+
+        /* A cache that is too small or of another layout is replaced */
+        if (mapped && (sm.limit < limit || sm.layout != SIEVE_ODD)) {
+            unmapsieve(&sm);
+            mapped = 0;
+        }
+        if (!mapped) {
+            if ((sieve = gensieve_mt(limit, 0)) == NULL
+                    || savesieve(argv[2], sieve, limit, SIEVE_ODD) != 0) {
+                perror(argv[2]);
+                free(sieve);
+                return EXIT_FAILURE;
+            }
+            free(sieve);
+            if (mapsieve(&sm, argv[2], 1) != 0) {
+                fprintf(stderr, "%s: invalid sieve cache\n", argv[2]);
+                return EXIT_FAILURE;
             }
+        }
+        printf("Counted %lu (cached)\n", countprimes(sm.sieve, 0, limit));
+        unmapsieve(&sm);
+        return 0;
+    }
+
+    /* The flat sieve needs limit / 16 bytes, so only try it for small limits */
+    if (limit <= SIEVELIMIT && (sieve = gensieve(limit)) != NULL) {
+        count = 0;
+        for (i = nextprime(sieve, limit, 0); i; i = nextprime(sieve, limit, i + 1)) {
+            count++;
+            //printf("%lu (#%lu)\n", i, count);
+        }
         printf("Counted %lu\n", count);
+        printf("Counted %lu (popcount)\n", countprimes(sieve, 0, limit));
+        if (sieveindex_init(&ix, sieve, limit) == 0) {
+            printf("Counted %lu (index)", primepi(&ix, limit - 1));
+            if (ix.nprimes)
+                printf(", largest %lu", nthprime(&ix, ix.nprimes));
+            putchar('\n');
+            sieveindex_free(&ix);
+        }
         free(sieve);            
     }
 
+    /* nthprime() against nextprime() where pi(limit) is a multiple of
+     * SELECTSAMPLE (pi(84020) == 8192)
+     */
+    if ((sieve = gensieve(84020)) != NULL) {
+        if (sieveindex_init(&ix, sieve, 84020) == 0) {
+            count = 0;
+            for (i = nextprime(sieve, 84020, 0); i;
+                    i = nextprime(sieve, 84020, i + 1))
+                if (nthprime(&ix, ++count) != i)
+                    break;
+            printf("nthprime() %s to %lu\n",
+                   i == 0 && count == ix.nprimes ? "matches" : "MISMATCH",
+                   count);
+            sieveindex_free(&ix);
+        }
+        free(sieve);
+    }
+
+    if (limit <= SIEVELIMIT && (sieve = gensieve_mt(limit, 0)) != NULL) {
+        count = 0;
+        for (i = 0; i < limit; i++)
+            if (checkprime(sieve, i))
+                count++;
+        printf("Counted %lu (parallel)\n", count);
+        free(sieve);
+    }
+
+    if (limit <= SIEVELIMIT && (sieve = gensieve30(limit)) != NULL) {
+        count = 0;
+        for (i = 0; i < limit; i++)
+            if (checkprime30(sieve, i))
+                count++;
+        printf("Counted %lu (mod 30 wheel)\n", count);
+        free(sieve);
+    }
+
+    /* Check the batch test against the sieve: everything below 'limit' is
+     * answered from the sieve and the next 65536 numbers by Miller-Rabin
+     */
+    if (limit <= SIEVELIMIT && (sieve = gensieve(limit)) != NULL) {
+        uint64_t nums[1024];
+        unsigned char isp[1024];
+        unsigned long n;
+        size_t k;
+
+        count = 0;
+        for (n = 0; n < limit + 65536; n += 1024) {
+            for (k = 0; k < 1024; k++)
+                nums[k] = n + k;
+            checkprimes(sieve, limit, nums, 1024, isp);
+            for (k = 0; k < 1024; k++)
+                count += isp[k];
+        }
+        printf("Counted %lu (batch, to %lu)\n", count, n);
+        free(sieve);
+    }
+
+    if (limit <= SIEVELIMIT && (gs = growsieve_new()) != NULL) {
+        count = 0;
+        for (i = 0; i < limit; i++)
+            if (growsieve_checkprime(gs, i) == 1)
+                count++;
+        printf("Counted %lu (growable, up to %lu)\n", count,
+               growsieve_limit(gs));
+        growsieve_dispose(gs);
+    }
+
+    if ((ss = malloc(sizeof *ss)) != NULL
+            && segsieve_init(ss, 0, limit) == 0) {
+        count = 0;
+        while ((seg = segsieve_next(ss, &lo, &hi)) != NULL)
+            count += countprimesseg(seg, lo, hi);
+        printf("Counted %lu (segmented)\n", count);
+        segsieve_free(ss);
+    }
+    free(ss);
+
     return 0;
 }
 
@@ -52,15 +380,16 @@ gensieve(unsigned long limit)
     unsigned char *bitarr;
     unsigned long arrsz, i, j, chklim;
     
-    arrsz = ceilpow2(limit / 2, BYTEBITS) / BYTEBITS;
+    arrsz = ceilpow2(limit / 2, WORDBITS) / BYTEBITS;
     
-    if ((bitarr = malloc(arrsz)) == NULL)
+    if ((bitarr = malloc(arrsz ? arrsz : sizeof(sieveword))) == NULL)
         return NULL;
     
-    memset(bitarr, 0x00, arrsz);     /* Init with all as not deleted */
+    /* Init with multiples of 3 .. PRESIEVEMAX deleted, the rest not */
+    presieve((sieveword *)bitarr, 0, arrsz / sizeof(sieveword));
     chklim = sqrt(limit);
     
-    for (i = 3; i <= chklim; i += 2)
+    for (i = PRESIEVEMAX + 2; i <= chklim; i += 2)
         if (!isbitset(bitarr, i / 2))
             for (j = i * i; j < limit; j += i + i)
                 setbit(bitarr, j / 2);
@@ -80,9 +409,1400 @@ checkprime(const unsigned char *sieve, unsigned long n)
     return !isbitset(sieve, n / 2);
 } 
 
+/*************************************************************************
+ * Pre-sieving
+ *
+ * Most of the writes in a sieve are for the smallest primes. Their combined
+ * pattern is periodic, so it is built once and copied into each new array
+ * or segment with memcpy() instead.
+ ************************************************************************/
+
+static const unsigned char presieveprimes[] = { 3, 5, 7, 11, 13 };
+
+static sieveword presievepat[PRESIEVEWORDS];
+static pthread_once_t presieveonce = PTHREAD_ONCE_INIT;
+
+static void
+presieve_init_(void)
+{
+    unsigned long b;
+    size_t i;
+
+    for (i = 0; i < sizeof presieveprimes; i++)
+        for (b = presieveprimes[i] / 2; b < PRESIEVEWORDS * WORDBITS;
+                b += presieveprimes[i])
+            setbit(presievepat, b);
+}
+
+/* Initialise the 'nwords' words of an odd-only bit array that starts at bit
+ * 'bitlo' (the number 2 * bitlo + 1) with the odd multiples of 3 ..
+ * PRESIEVEMAX deleted and everything else not deleted.
+ */
+void
+presieve(sieveword *words, unsigned long bitlo, unsigned long nwords)
+{
+    unsigned long k, n, shift, b;
+    size_t i;
+
+    pthread_once(&presieveonce, presieve_init_);
+
+    k = bitlo / WORDBITS % PRESIEVEWORDS;
+    shift = bitlo & WORDMASK;
+    if (shift == 0) {
+        for (i = 0; i < nwords; i += n, k = 0) {
+            n = PRESIEVEWORDS - k < nwords - i ? PRESIEVEWORDS - k : nwords - i;
+            memcpy(words + i, presievepat + k, n * sizeof *words);
+        }
+    } else {
+        for (i = 0; i < nwords; i++) {
+            n = k + 1 < PRESIEVEWORDS ? k + 1 : 0;
+            words[i] = presievepat[k] >> shift
+                       | presievepat[n] << (WORDBITS - shift);
+            k = n;
+        }
+    }
+
+    /* The primes themselves were deleted along with their multiples */
+    for (i = 0; i < sizeof presieveprimes; i++) {
+        b = presieveprimes[i] / 2;
+        if (b >= bitlo && b - bitlo < nwords * WORDBITS)
+            clrbit(words, b - bitlo);
+    }
+}
+
+/*************************************************************************
+ * Segmented sieve
+ *
+ * Sieves [lo, limit) one SEGBYTES segment at a time using the odd primes up
+ * to sqrt(limit), so memory is O(sqrt(limit)) however large 'limit' is.
+ * Each segment uses the same odd-only layout as gensieve() offset by 'lo':
+ * odd n is bit (n - lo) / 2. Base primes below SEGBITS are crossed off
+ * segment by segment with sieveseg(); larger ones go through the buckets
+ * (after Oliveira e Silva), so a segment only touches the primes that
+ * actually hit it.
+ ************************************************************************/
+
+/* Returns the odd primes p with p * p < limit (the primes needed to sieve up
+ * to 'limit') and stores how many in 'count'. The caller frees the result.
+ */
+unsigned long *
+baseprimes(unsigned long limit, unsigned long *count)
+{
+    unsigned char *sieve;
+    unsigned long *primes, r, n, i;
+
+    /* r = floor(sqrt(limit - 1)), the largest candidate; sqrt() is only a
+     * first guess and the divisions avoid overflowing r * r.
+     */
+    n = limit ? limit - 1 : 0;
+    r = sqrt(n);
+    while (r > 0 && r > n / r)
+        r--;
+    while (r + 1 <= n / (r + 1))
+        r++;
+
+    if ((sieve = gensieve(r + 1)) == NULL)
+        return NULL;
+    if ((primes = malloc((countprimes(sieve, 0, r + 1) + 1) * sizeof *primes))
+            == NULL) {
+        free(sieve);
+        return NULL;
+    }
+
+    i = 0;
+    for (n = nextprime(sieve, r + 1, 3); n; n = nextprime(sieve, r + 1, n + 1))
+        primes[i++] = n;
+    free(sieve);
+
+    *count = i;
+    return primes;
+}
+
+/* Set next[i] to the bit index of the first odd multiple of primes[i] that
+ * is >= lo and not below primes[i] squared. 'lo' must be even.
+ */
+void
+segstart(const unsigned long *primes, unsigned long nprimes,
+         unsigned long *next, unsigned long lo)
+{
+    unsigned long i, p, m, r;
+
+    for (i = 0; i < nprimes; i++) {
+        p = primes[i];
+        m = p * p;
+        if (m < lo) {
+            r = lo % p;
+            m = r ? lo + (p - r) : lo;
+            if (!(m & 1))
+                m += p;
+            if (m < lo)             /* Wrapped: no multiple left */
+                m = ULONG_MAX;
+        }
+        next[i] = m / 2;
+    }
+}
+
+/* Cross off the odd composites in [lo, hi) in the segment 'seg', which has
+ * been through presieve(), and advance next[] past hi. 'lo' must be even.
+ */
+void
+sieveseg(unsigned char *seg, unsigned long lo, unsigned long hi,
+         const unsigned long *primes, unsigned long nprimes,
+         unsigned long *next)
+{
+    unsigned long i, p, j, bitlo, bithi;
+
+    bitlo = lo / 2;
+    bithi = bitlo + (hi - lo) / 2;  /* Odd numbers in [lo, hi) */
+
+    for (i = 0; i < nprimes; i++) {
+        p = primes[i];
+        if (p <= PRESIEVEMAX)
+            continue;
+        if (p * p >= hi)
+            break;
+        for (j = next[i]; j < bithi; j += p)
+            setbit(seg, j - bitlo);
+        next[i] = j;
+    }
+}
+
+/* Prepare to sieve [lo, limit). 'lo' is rounded down to an even number.
+ * Returns 0 on success or -1 if memory could not be allocated.
+ */
+int
+segsieve_init(struct segsieve *s, unsigned long lo, unsigned long limit)
+{
+    unsigned long i, nblks, maxp;
+
+    if ((s->primes = baseprimes(limit, &s->nprimes)) == NULL)
+        return -1;
+    if ((s->next = malloc((s->nprimes + 1) * sizeof *s->next)) == NULL) {
+        free(s->primes);
+        return -1;
+    }
+
+    s->lo = lo & ~1UL;
+    s->limit = limit;
+    segstart(s->primes, s->nprimes, s->next, s->lo);
+
+    for (s->nsmall = 0; s->nsmall < s->nprimes; s->nsmall++)
+        if (s->primes[s->nsmall] >= SEGBITS)
+            break;
+    s->nadded = s->nsmall;
+
+    /* A large prime is never more than maxp / SEGBITS + 1 segments ahead.
+     * Each one is in exactly one bucket, so this many blocks always do.
+     */
+    maxp = s->nprimes ? s->primes[s->nprimes - 1] : 0;
+    s->nbuckets = maxp / SEGBITS + 2;
+    nblks = (s->nprimes - s->nsmall) / BUCKETENTS + s->nbuckets;
+    s->segno = 0;
+    s->buckets = calloc(s->nbuckets, sizeof *s->buckets);
+    s->blkpool = malloc(nblks * sizeof *s->blkpool);
+    if (s->buckets == NULL || s->blkpool == NULL) {
+        free(s->buckets);
+        free(s->blkpool);
+        free(s->next);
+        free(s->primes);
+        return -1;
+    }
+    s->freeblks = NULL;
+    for (i = 0; i < nblks; i++) {
+        s->blkpool[i].next = s->freeblks;
+        s->freeblks = &s->blkpool[i];
+    }
+
+    return 0;
+}
+
+/* Schedule 'p' for bit 'bit' of the segment 'ahead' segments from now */
+inline static void
+bucket_push_(struct segsieve *s, unsigned long ahead, unsigned long p,
+             unsigned long bit)
+{
+    struct bucketblk **head, *blk;
+
+    head = &s->buckets[(s->segno + ahead) % s->nbuckets];
+    blk = *head;
+    if (blk == NULL || blk->n == BUCKETENTS) {
+        blk = s->freeblks;
+        s->freeblks = blk->next;
+        blk->next = *head;
+        blk->n = 0;
+        *head = blk;
+    }
+    blk->e[blk->n].prime = p;
+    blk->e[blk->n].bit = bit;
+    blk->n++;
+}
+
+/* Cross off the large primes due in the current segment, which has 'nbits'
+ * bits, and reschedule each for its next multiple.
+ */
+static void
+bucket_sieve_(struct segsieve *s, unsigned long nbits)
+{
+    struct bucketblk *blk, *nextblk;
+    unsigned long i, p, bit, rel;
+
+    /* Start the large primes whose first multiple is now in range */
+    while (s->nadded < s->nprimes) {
+        rel = s->next[s->nadded] - s->lo / 2;
+        if (rel / SEGBITS >= s->nbuckets)
+            break;
+        bucket_push_(s, rel / SEGBITS, s->primes[s->nadded], rel % SEGBITS);
+        s->nadded++;
+    }
+
+    blk = s->buckets[s->segno % s->nbuckets];
+    s->buckets[s->segno % s->nbuckets] = NULL;
+    for (; blk != NULL; blk = nextblk) {
+        for (i = 0; i < blk->n; i++) {
+            p = blk->e[i].prime;
+            bit = blk->e[i].bit;
+            if (bit < nbits)
+                setbit(s->seg, bit);
+            bit += p;       /* p >= SEGBITS, so always a later segment */
+            bucket_push_(s, bit / SEGBITS, p, bit % SEGBITS);
+        }
+        nextblk = blk->next;
+        blk->next = s->freeblks;
+        s->freeblks = blk;
+    }
+}
+
+/* Sieve the next segment. Returns the segment and stores the range it
+ * covers in 'lo' and 'hi' ([lo, hi)); returns NULL when the limit has been
+ * reached. Test numbers in the segment with checkprimeseg(). The segment is
+ * overwritten by the next call.
+ */
+const unsigned char *
+segsieve_next(struct segsieve *s, unsigned long *lo, unsigned long *hi)
+{
+    unsigned long seghi;
+
+    if (s->lo >= s->limit)
+        return NULL;
+
+    seghi = s->limit - s->lo < SEGSPAN ? s->limit : s->lo + SEGSPAN;
+    presieve(s->seg, s->lo / 2, SEGBYTES / sizeof(sieveword));
+    sieveseg((unsigned char *)s->seg, s->lo, seghi, s->primes, s->nsmall,
+             s->next);
+    bucket_sieve_(s, (seghi - s->lo) / 2);
+
+    *lo = s->lo;
+    *hi = seghi;
+    s->lo = seghi;
+    s->segno++;
+    return (const unsigned char *)s->seg;
+}
+
+/* Frees the base primes and buckets; the struct itself belongs to the
+ * caller
+ */
+void
+segsieve_free(struct segsieve *s)
+{
+    free(s->blkpool);
+    free(s->buckets);
+    free(s->primes);
+    free(s->next);
+}
+
+/* checkprime() for a segment starting at 'lo'; lo <= n < hi */
+unsigned char
+checkprimeseg(const unsigned char *seg, unsigned long lo, unsigned long n)
+{
+    if (n < 2)
+        return 0;
+    if (n == 2)
+        return 1;
+    if (!(n & 1))
+        return 0;
+    return !isbitset(seg, (n - lo) / 2);
+}
+
+/*************************************************************************
+ * Parallel sieve
+ *
+ * Builds the same bit array as gensieve() with a pool of worker threads.
+ * The array is cut into SEGBYTES segments (so no two threads write the
+ * same byte) and the workers take runs of PARCHUNK segments from a shared
+ * counter until none are left, which keeps them busy to the end even though
+ * the low segments are slower to sieve.
+ ************************************************************************/
+
+#define PARCHUNK 16     /* Segments handed out at a time */
+
+struct parsieve {
+    unsigned char *bitarr;
+    unsigned long arrsz;
+    unsigned long limit;
+    const unsigned long *primes;
+    unsigned long nprimes;
+
+    pthread_mutex_t lock;
+    unsigned long nextseg;      /* Next segment to hand out; under 'lock' */
+    unsigned long nsegs;
+    int failed;                 /* A worker could not allocate; under 'lock' */
+};
+
+static void *
+parsieve_worker(void *arg)
+{
+    struct parsieve *ps = arg;
+    unsigned long *next, first, k, lo, hi, off, len;
+
+    if ((next = malloc((ps->nprimes + 1) * sizeof *next)) == NULL) {
+        pthread_mutex_lock(&ps->lock);
+        ps->failed = 1;
+        pthread_mutex_unlock(&ps->lock);
+        return NULL;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&ps->lock);
+        first = ps->nextseg;
+        ps->nextseg += PARCHUNK;
+        pthread_mutex_unlock(&ps->lock);
+        if (first >= ps->nsegs)
+            break;
+
+        /* One division per prime per run; next[] carries on from there */
+        segstart(ps->primes, ps->nprimes, next, first * SEGSPAN);
+        for (k = first; k < first + PARCHUNK && k < ps->nsegs; k++) {
+            lo = k * SEGSPAN;
+            hi = ps->limit - lo < SEGSPAN ? ps->limit : lo + SEGSPAN;
+            off = k * SEGBYTES;
+            len = ps->arrsz - off < SEGBYTES ? ps->arrsz - off : SEGBYTES;
+            presieve((sieveword *)(ps->bitarr + off), lo / 2,
+                     len / sizeof(sieveword));
+            sieveseg(ps->bitarr + off, lo, hi, ps->primes, ps->nprimes, next);
+        }
+    }
+
+    free(next);
+    return NULL;
+}
+
+/* gensieve() using 'nthreads' threads (0 = one per online CPU). The result
+ * is identical and is freed the same way.
+ */
+unsigned char *
+gensieve_mt(unsigned long limit, int nthreads)
+{
+    struct parsieve ps;
+    pthread_t *threads;
+    unsigned long *primes;
+    int i, started;
+
+    if (nthreads <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpu > 0 ? ncpu : 1;
+    }
+
+    ps.limit = limit;
+    ps.arrsz = ceilpow2(limit / 2, WORDBITS) / BYTEBITS;
+    ps.nsegs = (ps.arrsz + SEGBYTES - 1) / SEGBYTES;
+    ps.nextseg = 0;
+    ps.failed = 0;
+
+    if ((ps.bitarr = malloc(ps.arrsz ? ps.arrsz : sizeof(sieveword))) == NULL)
+        return NULL;
+    if ((primes = baseprimes(limit, &ps.nprimes)) == NULL
+            || (threads = malloc(nthreads * sizeof *threads)) == NULL) {
+        free(primes);
+        free(ps.bitarr);
+        return NULL;
+    }
+    ps.primes = primes;
+    pthread_mutex_init(&ps.lock, NULL);
+
+    for (started = 0; started < nthreads; started++)
+        if (pthread_create(&threads[started], NULL, parsieve_worker, &ps) != 0)
+            break;
+    /* With no threads at all, do the work here */
+    if (started == 0)
+        parsieve_worker(&ps);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_mutex_destroy(&ps.lock);
+    free(threads);
+    free(primes);
+
+    /* Any segments a failed worker took are unfinished */
+    if (ps.failed) {
+        free(ps.bitarr);
+        return NULL;
+    }
+    return ps.bitarr;
+}
+
+/*************************************************************************
+ * Mod-30 wheel sieve
+ *
+ * Only numbers coprime to 30 are stored: byte k covers [30k, 30k + 30) with
+ * one bit for each of the 8 residues in wheel30[], so the array is
+ * limit / 30 bytes instead of limit / 16. A set bit means composite, as in
+ * gensieve().
+ *
+ * For a prime p the multiples p * q with q = 30a + w (w in the wheel) lie
+ * in byte p * a + (p * w) / 30, always at the same bit, so each of the 8
+ * residue classes of q is a run of bytes with step p.
+ ************************************************************************/
+
+static const unsigned char wheel30[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+
+/* Bit for each residue mod 30; -1 if the residue shares a factor with 30 */
+static const signed char wheelbit30[30] = {
+    -1,  0, -1, -1, -1, -1, -1,  1, -1, -1,
+    -1,  2, -1,  3, -1, -1, -1,  4, -1,  5,
+    -1, -1, -1,  6, -1, -1, -1, -1, -1,  7
+};
+
+/* Generate a mod-30 wheel sieve covering [0, limit); the caller frees it.
+ * 2, 3 and 5 are not in the sieve.
+ */
+unsigned char *
+gensieve30(unsigned long limit)
+{
+    unsigned char *bytearr;
+    unsigned long arrsz, chklim, k, p, q, m, b;
+    int i, j;
+
+    arrsz = (limit + 29) / 30;
+
+    if ((bytearr = malloc(arrsz ? arrsz : 1)) == NULL)
+        return NULL;
+
+    memset(bytearr, 0x00, arrsz);
+    chklim = sqrt(limit);
+
+    for (k = 0; k * 30 <= chklim; k++) {
+        for (i = 0; i < 8; i++) {
+            p = k * 30 + wheel30[i];
+            if (p < 7 || p > chklim || (bytearr[k] & (1U << i)))
+                continue;
+            /* Start each residue class at its first q >= p */
+            for (j = 0; j < 8; j++) {
+                q = p - p % 30 + wheel30[j];
+                if (q < p)
+                    q += 30;
+                m = p * q;
+                for (b = m / 30; b < arrsz; b += p)
+                    bytearr[b] |= 1U << wheelbit30[m % 30];
+            }
+        }
+    }
+
+    return bytearr;
+}
+
+unsigned char
+checkprime30(const unsigned char *sieve, unsigned long n)
+{
+    int bit;
+
+    if (n < 7)
+        return n == 2 || n == 3 || n == 5;
+    if ((bit = wheelbit30[n % 30]) < 0)
+        return 0;
+    return !(sieve[n / 30] & (1U << bit));
+}
+
+/*************************************************************************
+ * Counting and iterating
+ *
+ * These read the odd-only bit array a word at a time: a prime is a clear
+ * bit, so a word's primes are its zero bits, counted with popcount and found
+ * with count-trailing-zeros.
+ ************************************************************************/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/* Picks the POPCNT instruction at load time when the CPU has it */
+#   define SIEVE_POPCNT __attribute__((target_clones("popcnt", "default")))
+#else
+#   define SIEVE_POPCNT
+#endif
+
+/* Bit counting on a word; plain C where the builtins are not available.
+ * ctz_() and clz_() need x != 0.
+ */
+inline static int
+popcount_(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    x -= (x >> 1) & 0x5555555555555555;
+    x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+    return (int)((x * 0x0101010101010101) >> 56);
+#endif
+}
+
+inline static int
+ctz_(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    return popcount_((x & -x) - 1);
+#endif
+}
+
+inline static int
+clz_(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+
+    while (!(x & (uint64_t)1 << 63)) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+inline static sieveword
+loadword_(const unsigned char *bits, unsigned long w)
+{
+    return ((const sieveword *)bits)[w];
+}
+
+/* Number of clear bits in [b0, b1) */
+SIEVE_POPCNT static unsigned long
+countclear_(const unsigned char *bits, unsigned long b0, unsigned long b1)
+{
+    unsigned long w, w0, w1, set = 0;
+    sieveword x;
+
+    if (b0 >= b1)
+        return 0;
+
+    w0 = b0 / WORDBITS;
+    w1 = (b1 - 1) / WORDBITS;
+    for (w = w0; w <= w1; w++) {
+        x = loadword_(bits, w);
+        if (w == w0)
+            x &= ~0ULL << (b0 & WORDMASK);
+        if (w == w1 && b1 & WORDMASK)
+            x &= ~(~0ULL << (b1 & WORDMASK));
+        set += popcount_(x);
+    }
+    return (b1 - b0) - set;
+}
+
+/* Number of primes in [lo, hi) using a sieve from gensieve(); hi must not
+ * exceed the sieve's limit.
+ */
+unsigned long
+countprimes(const unsigned char *sieve, unsigned long lo, unsigned long hi)
+{
+    unsigned long count;
+
+    if (lo >= hi)
+        return 0;
+
+    /* Odd n is bit n / 2, so bits [lo / 2, hi / 2) are the odd numbers */
+    count = countclear_(sieve, lo / 2, hi / 2);
+    if (lo <= 1 && hi > 1)      /* 1 has a clear bit but is not prime */
+        count--;
+    if (lo <= 2 && hi > 2)      /* 2 has no bit */
+        count++;
+    return count;
+}
+
+/* countprimes() for a segment from segsieve_next() covering [lo, hi) */
+unsigned long
+countprimesseg(const unsigned char *seg, unsigned long lo, unsigned long hi)
+{
+    unsigned long count;
+
+    count = countclear_(seg, 0, (hi - lo) / 2);
+    if (lo <= 1 && hi > 1)
+        count--;
+    if (lo <= 2 && hi > 2)
+        count++;
+    return count;
+}
+
+/* Returns the smallest prime >= n that is below 'limit' or 0 if there is
+ * none. Iterate with
+ *     for (p = nextprime(s, limit, 0); p; p = nextprime(s, limit, p + 1))
+ */
+unsigned long
+nextprime(const unsigned char *sieve, unsigned long limit, unsigned long n)
+{
+    unsigned long b, bend, w;
+    sieveword x;
+
+    if (n <= 2)
+        return limit > 2 ? 2 : 0;
+
+    b = n / 2;                  /* First odd number >= n */
+    bend = limit / 2;           /* Odd numbers below limit */
+    if (b >= bend)
+        return 0;
+
+    w = b / WORDBITS;
+    x = ~loadword_(sieve, w) & (~0ULL << (b & WORDMASK));
+    while (x == 0) {
+        if (++w * WORDBITS >= bend)
+            return 0;
+        x = ~loadword_(sieve, w);
+    }
+
+    b = w * WORDBITS + ctz_(x);
+    return b < bend ? 2 * b + 1 : 0;
+}
+
+/*************************************************************************
+ * Rank/select index
+ *
+ * primepi() is a superblock count, a block count and at most
+ * RANKBLOCKBITS / WORDBITS popcounts. nthprime() starts from a sample,
+ * binary searches the blocks up to the next sample and finishes in one
+ * block.
+ ************************************************************************/
+
+/* Clear bits among the first 'b' bits of the sieve (b <= ix->nbits) */
+SIEVE_POPCNT static unsigned long
+rank0_(const struct sieveindex *ix, unsigned long b)
+{
+    unsigned long w, r;
+
+    r = ix->super[b / RANKSUPERBITS] + ix->block[b / RANKBLOCKBITS];
+    for (w = b / RANKBLOCKBITS * (RANKBLOCKBITS / WORDBITS);
+            w < b / WORDBITS; w++)
+        r += popcount_(~loadword_(ix->sieve, w));
+    if (b & WORDMASK)
+        r += popcount_(~loadword_(ix->sieve, w)
+                                  & ~(~(sieveword)0 << (b & WORDMASK)));
+    return r;
+}
+
+/* Build the index for a sieve from gensieve() (or mapsieve()) covering
+ * [0, limit). The sieve must stay valid while the index is used. Returns 0
+ * on success or -1 if memory could not be allocated.
+ */
+SIEVE_POPCNT int
+sieveindex_init(struct sieveindex *ix, const unsigned char *sieve,
+                unsigned long limit)
+{
+    unsigned long nwords, w, b, zeros, c, nsamples, ns;
+    sieveword x;
+
+    ix->sieve = sieve;
+    ix->limit = limit;
+    ix->nbits = limit / 2;
+    nwords = (ix->nbits + WORDMASK) / WORDBITS;
+
+    zeros = countclear_(sieve, 0, ix->nbits);
+    nsamples = zeros / SELECTSAMPLE + 1;
+    ix->nprimes = limit > 2 ? zeros : 0;    /* 2 in for 1 out */
+
+    ix->super = malloc((ix->nbits / RANKSUPERBITS + 1) * sizeof *ix->super);
+    ix->block = malloc((ix->nbits / RANKBLOCKBITS + 1) * sizeof *ix->block);
+    ix->sample = malloc(nsamples * sizeof *ix->sample);
+    if (ix->super == NULL || ix->block == NULL || ix->sample == NULL) {
+        sieveindex_free(ix);
+        return -1;
+    }
+
+    zeros = 0;
+    ns = 0;
+    for (w = 0; ; w++) {
+        b = w * WORDBITS;
+        if (b % RANKSUPERBITS == 0 && b <= ix->nbits)
+            ix->super[b / RANKSUPERBITS] = zeros;
+        if (b % RANKBLOCKBITS == 0 && b <= ix->nbits)
+            ix->block[b / RANKBLOCKBITS] = zeros
+                                           - ix->super[b / RANKSUPERBITS];
+        if (w == nwords)
+            break;
+
+        x = ~loadword_(sieve, w);
+        if (ix->nbits - b < WORDBITS)   /* Ignore the padding */
+            x &= ~(~(sieveword)0 << (ix->nbits - b));
+        c = popcount_(x);
+        /* Sample j is the block holding clear bit j * SELECTSAMPLE + 1 */
+        while (ns < nsamples && ns * SELECTSAMPLE + 1 <= zeros + c)
+            ix->sample[ns++] = b / RANKBLOCKBITS;
+        zeros += c;
+    }
+    /* With a multiple of SELECTSAMPLE clear bits the last sample is past
+     * them all; nthprime() still uses it as the upper end of its search
+     */
+    while (ns < nsamples)
+        ix->sample[ns++] = ix->nbits / RANKBLOCKBITS;
+
+    return 0;
+}
+
+void
+sieveindex_free(struct sieveindex *ix)
+{
+    free(ix->super);
+    free(ix->block);
+    free(ix->sample);
+}
+
+/* Number of primes <= n; n must be below the sieve's limit */
+unsigned long
+primepi(const struct sieveindex *ix, unsigned long n)
+{
+    if (n < 2)
+        return 0;
+    /* Odd numbers <= n are bits [0, (n + 1) / 2); counting 1 there makes
+     * up for 2 not having a bit.
+     */
+    return rank0_(ix, (n + 1) / 2);
+}
+
+/* The k-th prime (nthprime(ix, 1) is 2) or 0 if there are fewer than k
+ * primes below the sieve's limit
+ */
+SIEVE_POPCNT unsigned long
+nthprime(const struct sieveindex *ix, unsigned long k)
+{
+    unsigned long lo, hi, mid, w, c;
+    sieveword x;
+
+    if (k == 0 || k > ix->nprimes)
+        return 0;
+    if (k == 1)
+        return 2;
+
+    /* The k-th prime is the k-th clear bit, 1 taking the place of 2.
+     * Find the last block with fewer than k clear bits before it.
+     */
+    lo = ix->sample[(k - 1) / SELECTSAMPLE];
+    hi = (k - 1) / SELECTSAMPLE + 1 < ix->nprimes / SELECTSAMPLE + 1
+         ? ix->sample[(k - 1) / SELECTSAMPLE + 1]
+         : ix->nbits / RANKBLOCKBITS;
+    while (lo < hi) {
+        mid = lo + (hi - lo + 1) / 2;
+        if (ix->super[mid * RANKBLOCKBITS / RANKSUPERBITS] + ix->block[mid]
+                < k)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    k -= ix->super[lo * RANKBLOCKBITS / RANKSUPERBITS] + ix->block[lo];
+    for (w = lo * (RANKBLOCKBITS / WORDBITS); ; w++) {
+        x = ~loadword_(ix->sieve, w);
+        c = popcount_(x);
+        if (c >= k)
+            break;
+        k -= c;
+    }
+    while (--k)
+        x &= x - 1;
+    return 2 * (w * WORDBITS + ctz_(x)) + 1;
+}
+
+/*************************************************************************
+ * Batch primality
+ *
+ * Numbers below the sieve's limit are looked up; the rest get a quick
+ * trial division and then Miller-Rabin with the bases in mrbases[], which
+ * is deterministic for all n < 2^64 (the set found by Jim Sinclair).
+ * Arithmetic is in Montgomery form so there are no divisions in the inner
+ * loop, and MRLANES numbers are tested in lockstep so that their
+ * independent multiplications overlap instead of waiting on each other.
+ *
+ * The 128-bit products use unsigned __int128 where the compiler has it and
+ * 32-bit halves otherwise.
+ ************************************************************************/
+
+#define MRLANES 8
+
+static const uint64_t mrbases[] = {
+    2, 325, 9375, 28178, 450775, 9780504, 1795265022
+};
+
+/* p, p^-1 mod 2^64 and (2^64 - 1) / p: n is divisible by p exactly when
+ * n * p^-1 mod 2^64 <= (2^64 - 1) / p
+ */
+static const struct { uint64_t p, inv, max; } trialprimes[] = {
+    {  3, 0xaaaaaaaaaaaaaaabULL, 0x5555555555555555ULL },
+    {  5, 0xcccccccccccccccdULL, 0x3333333333333333ULL },
+    {  7, 0x6db6db6db6db6db7ULL, 0x2492492492492492ULL },
+    { 11, 0x2e8ba2e8ba2e8ba3ULL, 0x1745d1745d1745d1ULL },
+    { 13, 0x4ec4ec4ec4ec4ec5ULL, 0x13b13b13b13b13b1ULL },
+    { 17, 0xf0f0f0f0f0f0f0f1ULL, 0x0f0f0f0f0f0f0f0fULL },
+    { 19, 0x86bca1af286bca1bULL, 0x0d79435e50d79435ULL },
+    { 23, 0xd37a6f4de9bd37a7ULL, 0x0b21642c8590b216ULL },
+    { 29, 0x34f72c234f72c235ULL, 0x08d3dcb08d3dcb08ULL },
+    { 31, 0xef7bdef7bdef7bdfULL, 0x0842108421084210ULL },
+    { 37, 0x14c1bacf914c1badULL, 0x06eb3e45306eb3e4ULL },
+    { 41, 0x8f9c18f9c18f9c19ULL, 0x063e7063e7063e70ULL },
+    { 43, 0x82fa0be82fa0be83ULL, 0x05f417d05f417d05ULL },
+    { 47, 0x51b3bea3677d46cfULL, 0x0572620ae4c415c9ULL },
+    { 53, 0x21cfb2b78c13521dULL, 0x04d4873ecade304dULL },
+};
+
+#define TRIALMAX 53
+
+/* One number under test, with its Montgomery constants (R = 2^64) */
+struct mrlane {
+    uint64_t n;
+    uint64_t ninv;      /* n^-1 mod R */
+    uint64_t r2;        /* R^2 mod n, to convert into Montgomery form */
+    uint64_t one;       /* 1 in Montgomery form (R mod n) */
+    uint64_t minus1;    /* n - 1 in Montgomery form */
+    uint64_t d;         /* n - 1 = d * 2^s, d odd */
+    int s;
+    int composite;
+};
+
+/* The 128-bit product a * b: returns the low half, the high half in *hi */
+inline static uint64_t
+mul128_(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 t = (unsigned __int128)a * b;
+
+    *hi = t >> 64;
+    return (uint64_t)t;
+#else
+    uint64_t al = a & 0xffffffff, ah = a >> 32;
+    uint64_t bl = b & 0xffffffff, bh = b >> 32;
+    uint64_t ll = al * bl, lh = al * bh, hl = ah * bl;
+    uint64_t mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+
+    *hi = ah * bh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return mid << 32 | (ll & 0xffffffff);
+#endif
+}
+
+/* a * b / R mod n for a, b < n. As m = ab * n^-1 mod R, ab and mn agree in
+ * the low 64 bits, so (ab - mn) / R is just the difference of the high
+ * halves and cannot overflow even for n close to 2^64.
+ */
+inline static uint64_t
+montmul_(uint64_t a, uint64_t b, uint64_t n, uint64_t ninv)
+{
+    uint64_t th, mh, m;
+
+    m = mul128_(a, b, &th) * ninv;
+    mul128_(m, n, &mh);
+    return th >= mh ? th - mh : th - mh + n;
+}
+
+static void
+mrlane_init_(struct mrlane *l, uint64_t n)
+{
+    uint64_t x, r1;
+    int i;
+
+    /* Newton's iteration doubles the correct low bits of the inverse each
+     * step; n is its own inverse mod 8.
+     */
+    for (x = n, i = 0; i < 5; i++)
+        x *= 2 - n * x;
+    l->n = n;
+    l->ninv = x;
+    r1 = -n % n;
+#ifdef __SIZEOF_INT128__
+    l->r2 = (unsigned __int128)r1 * r1 % n;
+#else
+    /* R^2 = R * 2^64: double R mod n 64 times */
+    for (x = r1, i = 0; i < 64; i++)
+        x = x >= n - x ? x - (n - x) : x + x;
+    l->r2 = x;
+#endif
+    l->one = r1;
+    l->minus1 = n - r1;
+    l->d = n - 1;
+    for (l->s = 0; !(l->d & 1); l->s++)
+        l->d >>= 1;
+    l->composite = 0;
+}
+
+/* Run all the Miller-Rabin rounds on MRLANES odd numbers > TRIALMAX */
+static void
+mrtest_(struct mrlane *lanes)
+{
+    uint64_t x[MRLANES], am[MRLANES], y, dmax;
+    size_t b;
+    int i, k, bit, nbits, alive;
+
+    dmax = 0;
+    for (i = 0; i < MRLANES; i++)
+        dmax |= lanes[i].d;
+    nbits = 64 - clz_(dmax);
+
+    for (b = 0; b < sizeof mrbases / sizeof mrbases[0]; b++) {
+        alive = 0;
+        for (i = 0; i < MRLANES; i++) {
+            struct mrlane *l = &lanes[i];
+
+            alive |= !l->composite;
+            am[i] = montmul_(mrbases[b] % l->n, l->r2, l->n, l->ninv);
+            x[i] = l->one;
+        }
+        if (!alive)
+            return;
+
+        /* x = a^d, left to right. Every lane squares and multiplies on
+         * every step (keeping the result only if the bit is set) so the
+         * lanes stay in step; leading zero bits just square 1.
+         */
+        for (bit = nbits - 1; bit >= 0; bit--) {
+            for (i = 0; i < MRLANES; i++) {
+                x[i] = montmul_(x[i], x[i], lanes[i].n, lanes[i].ninv);
+                y = montmul_(x[i], am[i], lanes[i].n, lanes[i].ninv);
+                x[i] = (lanes[i].d >> bit) & 1 ? y : x[i];
+            }
+        }
+
+        for (i = 0; i < MRLANES; i++) {
+            struct mrlane *l = &lanes[i];
+
+            /* a multiple of n as base proves nothing */
+            if (l->composite || am[i] == 0
+                    || x[i] == l->one || x[i] == l->minus1)
+                continue;
+            for (k = 1; k < l->s; k++) {
+                x[i] = montmul_(x[i], x[i], l->n, l->ninv);
+                if (x[i] == l->minus1 || x[i] == l->one)
+                    break;
+            }
+            if (k == l->s || x[i] != l->minus1)
+                l->composite = 1;
+        }
+    }
+}
+
+/* Set out[i] to 1 if nums[i] is prime, otherwise 0. Numbers below 'limit'
+ * are looked up in 'sieve' (from gensieve(); NULL with a limit of 0 for
+ * none) and the rest are tested with Miller-Rabin.
+ */
+void
+checkprimes(const unsigned char *sieve, unsigned long limit,
+            const uint64_t *nums, size_t n, unsigned char *out)
+{
+    struct mrlane lanes[MRLANES];
+    size_t idx[MRLANES], i, t;
+    uint64_t v;
+    int k, nl = 0;
+
+    for (i = 0; i < n; i++) {
+        v = nums[i];
+        if (v < limit) {
+            out[i] = checkprime(sieve, v);
+            continue;
+        }
+        if (v <= TRIALMAX || !(v & 1)) {
+            out[i] = v == 2;
+            for (t = 0; t < sizeof trialprimes / sizeof trialprimes[0]; t++)
+                out[i] |= v == trialprimes[t].p;
+            continue;
+        }
+        for (t = 0; t < sizeof trialprimes / sizeof trialprimes[0]; t++)
+            if (v * trialprimes[t].inv <= trialprimes[t].max)
+                break;
+        if (t < sizeof trialprimes / sizeof trialprimes[0]) {
+            out[i] = 0;
+            continue;
+        }
+
+        mrlane_init_(&lanes[nl], v);
+        idx[nl++] = i;
+        if (nl == MRLANES) {
+            mrtest_(lanes);
+            for (k = 0; k < nl; k++)
+                out[idx[k]] = !lanes[k].composite;
+            nl = 0;
+        }
+    }
+
+    if (nl > 0) {
+        /* Fill the spare lanes with copies; their results are dropped */
+        for (k = nl; k < MRLANES; k++)
+            lanes[k] = lanes[0];
+        mrtest_(lanes);
+        for (k = 0; k < nl; k++)
+            out[idx[k]] = !lanes[k].composite;
+    }
+}
+
+/*************************************************************************
+ * Range sieve
+ *
+ * Sieves only [a, b] with the base primes up to sqrt(b), so the cost is
+ * proportional to the width of the window (plus one division per base
+ * prime) however high it lies. The window is sieved SEGBYTES at a time to
+ * stay in cache.
+ ************************************************************************/
+
+/* Sieve [lo, hi) into the 'nwords' words of 'bits' a segment at a time.
+ * 'primes' must reach sqrt(hi); 'next' is scratch space for as many.
+ */
+static void
+sievewindow_(sieveword *bits, unsigned long nwords, unsigned long lo,
+             unsigned long hi, const unsigned long *primes,
+             unsigned long nprimes, unsigned long *next)
+{
+    unsigned long seglo, seghi, k, n;
+
+    segstart(primes, nprimes, next, lo);
+    for (k = 0; k < nwords; k += n) {
+        n = SEGBYTES / sizeof *bits;
+        if (n > nwords - k)
+            n = nwords - k;
+        seglo = lo + k * WORDBITS * 2;
+        seghi = hi - seglo < n * WORDBITS * 2 ? hi : seglo + n * WORDBITS * 2;
+        presieve(bits + k, seglo / 2, n);
+        if (seglo < seghi)
+            sieveseg((unsigned char *)(bits + k), seglo, seghi,
+                     primes, nprimes, next);
+    }
+}
+
+/* Returns a bit array for [a, b] in the segment layout: test n with
+ * checkprimeseg(bits, a & ~1, n) and count with
+ * countprimesseg(bits, a & ~1, b + 1). The caller frees it. b must be less
+ * than ULONG_MAX.
+ */
+unsigned char *
+rangesieve(unsigned long a, unsigned long b)
+{
+    sieveword *bits;
+    unsigned long *primes, *next, nprimes, lo, hi, nwords;
+
+    if (a > b || b == ULONG_MAX)
+        return NULL;
+    lo = a & ~1UL;
+    hi = b + 1;
+    nwords = ceilpow2((hi - lo) / 2 + 1, WORDBITS) / WORDBITS;
+
+    if ((primes = baseprimes(hi, &nprimes)) == NULL)
+        return NULL;
+    next = malloc((nprimes + 1) * sizeof *next);
+    bits = malloc(nwords * sizeof *bits);
+    if (next == NULL || bits == NULL) {
+        free(bits);
+        free(next);
+        free(primes);
+        return NULL;
+    }
+
+    sievewindow_(bits, nwords, lo, hi, primes, nprimes, next);
+
+    free(next);
+    free(primes);
+    return (unsigned char *)bits;
+}
+
+/* Returns the primes in [a, b] in increasing order and stores how many in
+ * 'count'. The caller frees the result. Returns NULL on failure.
+ */
+unsigned long *
+rangeprimes(unsigned long a, unsigned long b, unsigned long *count)
+{
+    unsigned char *bits;
+    unsigned long *primes, lo, hi, nbits, w, i, n;
+    sieveword x;
+
+    if ((bits = rangesieve(a, b)) == NULL)
+        return NULL;
+    lo = a & ~1UL;
+    hi = b + 1;
+    nbits = (hi - lo) / 2;
+
+    /* Room for the odd primes plus 2 */
+    n = countclear_(bits, 0, nbits) + 1;
+    if ((primes = malloc(n * sizeof *primes)) == NULL) {
+        free(bits);
+        return NULL;
+    }
+
+    i = 0;
+    if (a <= 2 && b >= 2)
+        primes[i++] = 2;
+    for (w = 0; w * WORDBITS < nbits; w++) {
+        x = ~loadword_(bits, w);
+        while (x) {
+            n = lo + 2 * (w * WORDBITS + ctz_(x)) + 1;
+            x &= x - 1;
+            if (n >= hi)
+                break;
+            if (n >= a && n > 1)
+                primes[i++] = n;
+        }
+    }
+
+    free(bits);
+    *count = i;
+    return primes;
+}
+
+/*************************************************************************
+ * Growable sieve
+ *
+ * growsieve_checkprime() answers from the chunks when n is below the
+ * published limit and otherwise extends the sieve first. Extension sieves
+ * only the new chunks, at least doubling the size each time so a rising
+ * sequence of queries costs O(limit) overall.
+ ************************************************************************/
+
+/* Returns an empty sieve or NULL on failure */
+struct growsieve *
+growsieve_new(void)
+{
+    struct growsieve *g;
+
+    if ((g = calloc(1, sizeof *g)) == NULL)
+        return NULL;
+    atomic_init(&g->limit, 0);
+    pthread_mutex_init(&g->lock, NULL);
+    return g;
+}
+
+/* No other thread may be using the sieve */
+void
+growsieve_dispose(struct growsieve *g)
+{
+    unsigned long i;
+
+    for (i = 0; i < g->nchunks; i++)
+        free(g->chunks[i]);
+    pthread_mutex_destroy(&g->lock);
+    free(g);
+}
+
+/* Make sure everything below 'limit' is sieved. Readers may keep querying
+ * the existing range meanwhile. Returns 0 on success or -1 if memory ran
+ * out or 'limit' is beyond GROWMAXCHUNKS chunks.
+ */
+int
+growsieve_extend(struct growsieve *g, unsigned long limit)
+{
+    unsigned long *primes, *next, nprimes, want, c, lo;
+    sieveword *chunk;
+    int ret = 0;
+
+    if (limit <= atomic_load_explicit(&g->limit, memory_order_acquire))
+        return 0;
+    if (limit > (unsigned long)GROWMAXCHUNKS * GROWCHUNKSPAN)
+        return -1;
+
+    pthread_mutex_lock(&g->lock);
+    want = (limit + GROWCHUNKSPAN - 1) / GROWCHUNKSPAN;
+    if (want > g->nchunks) {
+        if (want < 2 * g->nchunks)
+            want = 2 * g->nchunks < GROWMAXCHUNKS ? 2 * g->nchunks
+                                                   : GROWMAXCHUNKS;
+        primes = baseprimes(want * GROWCHUNKSPAN, &nprimes);
+        next = primes ? malloc((nprimes + 1) * sizeof *next) : NULL;
+        if (next == NULL)
+            ret = -1;
+
+        for (c = g->nchunks; ret == 0 && c < want; c++) {
+            if ((chunk = malloc(GROWCHUNKBYTES)) == NULL) {
+                ret = -1;
+                break;
+            }
+            lo = c * GROWCHUNKSPAN;
+            sievewindow_(chunk, GROWCHUNKBYTES / sizeof *chunk, lo,
+                         lo + GROWCHUNKSPAN, primes, nprimes, next);
+            /* Publish each chunk as it is done */
+            g->chunks[c] = chunk;
+            g->nchunks = c + 1;
+            atomic_store_explicit(&g->limit, (c + 1) * GROWCHUNKSPAN,
+                                  memory_order_release);
+        }
+
+        free(next);
+        free(primes);
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    return limit <= growsieve_limit(g) ? 0 : -1;
+}
+
+/* Everything below this is sieved */
+unsigned long
+growsieve_limit(struct growsieve *g)
+{
+    return atomic_load_explicit(&g->limit, memory_order_acquire);
+}
+
+/* checkprime() that extends the sieve as needed. Returns -1 if the sieve
+ * could not be extended to 'n'.
+ */
+int
+growsieve_checkprime(struct growsieve *g, unsigned long n)
+{
+    const sieveword *chunk;
+
+    if (n < 2)
+        return 0;
+    if (n == 2)
+        return 1;
+    if (!(n & 1))
+        return 0;
+    if (n >= atomic_load_explicit(&g->limit, memory_order_acquire)
+            && growsieve_extend(g, n + 1) != 0)
+        return -1;
+
+    chunk = g->chunks[n / GROWCHUNKSPAN];
+    return !isbitset(chunk, n % GROWCHUNKSPAN / 2);
+}
+
+/*************************************************************************
+ * Sieve cache files
+ *
+ * savesieve() writes a sieve once; mapsieve() maps it read-only, so startup
+ * costs no sieving and processes using the same file share its pages.
+ ************************************************************************/
+
+typedef char sievehdr_checksize_[sizeof(struct sievehdr) == 64 ? 1 : -1];
+
+static uint64_t
+fnv1a_(const unsigned char *p, size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (n--) {
+        h ^= *p++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* Size in bytes of the array for 'limit' in 'layout'; 0 for an unknown
+ * layout.
+ */
+unsigned long
+sievesize(unsigned long limit, int layout)
+{
+    switch (layout) {
+    case SIEVE_ODD:
+        return ceilpow2(limit / 2, WORDBITS) / BYTEBITS;
+    case SIEVE_WHEEL30:
+        return (limit + 29) / 30;
+    }
+    return 0;
+}
+
+/* Write 'sieve' to 'path'. The file is written under a temporary name and
+ * renamed into place, so readers never see a partial file. Returns 0 on
+ * success, -1 on failure (with errno set).
+ */
+int
+savesieve(const char *path, const unsigned char *sieve, unsigned long limit,
+          int layout)
+{
+    struct sievehdr hdr;
+    char *tmp;
+    FILE *fp;
+    int fd, ok;
+
+    memset(&hdr, 0, sizeof hdr);
+    memcpy(hdr.magic, SIEVEMAGIC, sizeof hdr.magic);
+    hdr.version = SIEVEVERSION;
+    hdr.layout = layout;
+    hdr.byteorder = SIEVEBYTEORDER;
+    hdr.limit = limit;
+    hdr.size = sievesize(limit, layout);
+    hdr.checksum = fnv1a_(sieve, hdr.size);
+
+    /* A unique temporary name, so writers racing to create the same
+     * cache do not share (and truncate) one file
+     */
+    if ((tmp = malloc(strlen(path) + 8)) == NULL)
+        return -1;
+    strcpy(tmp, path);
+    strcat(tmp, ".XXXXXX");
+
+    if ((fd = mkstemp(tmp)) == -1) {
+        free(tmp);
+        return -1;
+    }
+    /* mkstemp() makes it 0600; the cache is meant to be shared */
+    if (fchmod(fd, 0644) != 0 || (fp = fdopen(fd, "wb")) == NULL) {
+        close(fd);
+        remove(tmp);
+        free(tmp);
+        return -1;
+    }
+    ok = fwrite(&hdr, sizeof hdr, 1, fp) == 1
+         && fwrite(sieve, 1, hdr.size, fp) == hdr.size
+         && fflush(fp) == 0
+         && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok)
+        remove(tmp);
+    free(tmp);
+
+    return ok ? 0 : -1;
+}
+
+/* Map the sieve in 'path' read-only. The header is always checked; the
+ * checksum (which reads the whole file) only if 'verify' is non-zero.
+ * Returns 0 on success, -1 if the file cannot be mapped or is not a valid
+ * sieve for this host.
+ */
+int
+mapsieve(struct sievemap *m, const char *path, int verify)
+{
+    const struct sievehdr *hdr;
+    struct stat st;
+    void *base;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof *hdr) {
+        close(fd);
+        return -1;
+    }
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+
+    hdr = base;
+    if (memcmp(hdr->magic, SIEVEMAGIC, sizeof hdr->magic) != 0
+            || hdr->version != SIEVEVERSION
+            || hdr->byteorder != SIEVEBYTEORDER
+            || hdr->limit > ULONG_MAX
+            || hdr->size != sievesize(hdr->limit, hdr->layout)
+            || hdr->size > (uint64_t)st.st_size - sizeof *hdr
+            || (verify && fnv1a_((const unsigned char *)(hdr + 1), hdr->size)
+                          != hdr->checksum)) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    m->sieve = (const unsigned char *)(hdr + 1);
+    m->limit = hdr->limit;
+    m->layout = hdr->layout;
+    m->base = base;
+    m->len = st.st_size;
+    return 0;
+}
+
+void
+unmapsieve(struct sievemap *m)
+{
+    munmap(m->base, m->len);
+}
+
 /*************************************************************************
  * Bit-related functions
- * Could be macros or inline
+ * The bit arrays are accessed as sieveword words
  ************************************************************************/
 
 /* Rounds up 'n' to the nearest multiple of 'base2muliple' (which *must* 
@@ -96,25 +1816,25 @@ ceilpow2(unsigned long n, unsigned long base2multiple)
 }
 
 /* Sets 'b' in the bit array 'addr' */
-void
+inline static void
 setbit(void *addr, unsigned long b)
 {
-    unsigned char *p = addr;
-    p[b / BYTEBITS] |= (0x1UL << (b & BYTEMASK));
+    sieveword *p = addr;
+    p[b / WORDBITS] |= ((sieveword)1 << (b & WORDMASK));
 }
 
 /* Clears 'b' in the bit array 'addr' */
-void
+inline static void
 clrbit(void *addr, unsigned long b)
 {
-    unsigned char *p = addr;
-    p[b / BYTEBITS] &= ~(0x1UL << (b & BYTEMASK));
+    sieveword *p = addr;
+    p[b / WORDBITS] &= ~((sieveword)1 << (b & WORDMASK));
 }
 
 /* Returns 1 if 'b' in the bit array is set, otherwise 0 */
-unsigned char
+inline static unsigned char
 isbitset(const void *addr, unsigned long b)
 {
-    const unsigned char *p = addr;
-    return !!(p[b / BYTEBITS] & (0x1UL << (b & BYTEMASK)));
+    const sieveword *p = addr;
+    return !!(p[b / WORDBITS] & ((sieveword)1 << (b & WORDMASK)));
 }
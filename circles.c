@@ -5,7 +5,7 @@
 #include <SDL/SDL_image.h>
 #include <SDL/SDL_main.h>
 
-#define DEG2RAD(x) ((x) * 0.01745329251994329576923690768489)
+#include "sine.h"       /* Link with sine.c built with -DSINE_NO_MAIN -pthread */
 
 
 struct fpsctx {
@@ -31,13 +31,24 @@ SDL_Surface *surface = NULL;
 
 void make_pos_tables(void)
 {
+   struct sinetable sintab;
+   uint32_t phase;
    int i;
 
+   /* 128 entries: one per position */
+   if (sinetable_init(&sintab, 7, SINE_LINEAR) != 0) {
+        printf("Couldn't make the sine table\n");
+        exit(1);
+   }
+
    for (i = 0; i < 128; i++) {
         double v = i / 128.0 * 360 ;
-        x_positions[i] = (sin(DEG2RAD(v)) + 1) * 31 + 0.5    + 64;
-        y_positions[i] = (cos(DEG2RAD(v)) + 1) * 31 + 0.5    + OUT_HEIGHT - OUT_HEIGHT/3;
+        phase = sine_phase(v);
+        x_positions[i] = (sinetable_f(&sintab, phase) + 1) * 31 + 0.5    + 64;
+        /* cos is sin a quarter turn on */
+        y_positions[i] = (sinetable_f(&sintab, phase + 0x40000000) + 1) * 31 + 0.5    + OUT_HEIGHT - OUT_HEIGHT/3;
    }
+   sinetable_free(&sintab);
 }
 
 #define NUM_BLOBS     8
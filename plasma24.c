@@ -2,7 +2,7 @@
  * By CDR - September 2013
  * Rot13 Email: xqr.cflpu ng tznvy.pbz
  *
- * gcc -O3 -lm -lSDL filename.c
+ * gcc -O3 -DSINE_NO_MAIN plasma24.c sine.c -lm -lSDL -pthread
  */
 #include <SDL/SDL.h>
 #include <SDL/SDL_main.h>
@@ -13,8 +13,7 @@
 #include <math.h>
 #include <time.h>
 
-#define PI_OVER_180 (0.01745329252)
-#define DEG_TO_RAD(d) ((d)*PI_OVER_180)
+#include "sine.h"
 
 #define OUT_WIDTH  800
 #define OUT_HEIGHT 600
@@ -122,10 +121,15 @@ bool init(void)
     }
 
     // void init_offsetTable(void)
+    // One table entry per offset, so there is nothing to interpolate
     unsigned len = sizeof offsetTable / sizeof offsetTable[0];
+    struct sinetable sintab;
+    if (sinetable_init(&sintab, 9, SINE_LINEAR) != 0) return false;
     for (i = 0; i < len; i++) {
-        offsetTable[i] = sin(DEG_TO_RAD((double)i / len * 360.0)) * OFFSET_MAG;
+        uint32_t phase = sine_phase((double)i / len * 360.0);
+        offsetTable[i] = sinetable_f(&sintab, phase) * OFFSET_MAG;
     }
+    sinetable_free(&sintab);
 
     // set target fps
     initfpstimer(&fpstimer, TARGET_FPS);
@@ -0,0 +1,356 @@
+/*
+ * Conformance and throughput suite for rand/
+ *
+ * Conformance: randmt.c is checked bit for bit against the reference
+ * implementation (ref/mt19937ar.c, compiled in below) over many seeds and
+ * through every interface: mtrand_get() in both regeneration modes,
+ * mtrand_fill() with ragged sizes, mtrand_init_inplace(), mtrand_jump(),
+ * mtrand_split() and mtrand_double().
+ *
+ * Throughput: numbers/second, ns/number and TSC ticks/number (x86 only) for
+ * each engine and interface.
+ *
+ * Every result is printed as one JSON object per line; the exit status is
+ * non-zero if any conformance check failed.
+ *
+ * Build: cc -std=c11 -O2 -pthread benchrand.c randmt.c randmt64.c randsfmt.c
+ *           randdist.c mtring.c -lm
+ * Usage: benchrand [--seeds N] [--count N] [--no-bench]
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "randmt.h"
+#include "randmt64.h"
+#include "randsfmt.h"
+#include "randdist.h"
+#include "mtring.h"
+
+/* The reference implementation; its main() is not used */
+#define main mt19937ar_main
+#include "ref/mt19937ar.c"
+#undef main
+#undef N
+#undef M
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <x86intrin.h>
+#   define HAVE_TSC
+#endif
+
+#define DEFSEEDS        200         /* Seeds to check */
+#define CHECKLEN        5000        /* Numbers checked per seed */
+#define DEFCOUNT        100000000   /* Numbers per throughput test */
+#define BLOCK           65536       /* Buffer size for the fill tests */
+
+static int nfail;
+
+/**********************************************************************
+ * Conformance
+ **********************************************************************/
+
+/* Seed i of the test set: the edge cases first, then spread out */
+static unsigned long testseed(int i)
+{
+    static const unsigned long fixed[] = { 0, 1, 10, 5489, 0xffffffffUL };
+    int nfixed = sizeof fixed / sizeof fixed[0];
+
+    if (i < nfixed)
+        return fixed[i];
+    return (2654435761UL * (unsigned long)i) & 0xffffffffUL;
+}
+
+static void result(const char *test, int nseeds, int bad)
+{
+    printf("{\"suite\":\"conformance\",\"test\":\"%s\",\"seeds\":%d,"
+           "\"mismatches\":%d,\"result\":\"%s\"}\n",
+           test, nseeds, bad, bad ? "fail" : "pass");
+    nfail += bad != 0;
+}
+
+static int checkget(unsigned long seed, int mode)
+{
+    RAND_MT *mt = mtrand_new(seed);
+    int i, bad = 0;
+
+    mtrand_setmode(mt, mode);
+    init_genrand(seed);
+    for (i = 0; i < CHECKLEN; i++)
+        bad += mtrand_get(mt) != genrand_int32();
+    mtrand_dispose(mt);
+    return bad != 0;
+}
+
+static int checkfill(unsigned long seed)
+{
+    RAND_MT *mt = mtrand_new(seed);
+    uint32_t buf[CHECKLEN];
+    int i, n, bad = 0, done = 0;
+
+    init_genrand(seed);
+    /* Ragged sizes so that every offset within a block is hit */
+    for (n = 1; done + n <= CHECKLEN; done += n, n = n * 3 % 1021 + 1) {
+        mtrand_fill(mt, buf, n);
+        for (i = 0; i < n; i++)
+            bad += buf[i] != genrand_int32();
+        bad += mtrand_get(mt) != genrand_int32();
+        done++;
+    }
+    mtrand_dispose(mt);
+    return bad != 0;
+}
+
+static int checkinplace(unsigned long seed)
+{
+    /* RAND_MT_SIZE is a multiple of RAND_MT_ALIGN, so mem[1] is aligned too */
+    static _Alignas(RAND_MT_ALIGN) unsigned char mem[3][RAND_MT_SIZE];
+    RAND_MT *mt = mtrand_init_inplace(mem[1], seed);
+    int i, bad = 0;
+
+    init_genrand(seed);
+    for (i = 0; i < CHECKLEN; i++)
+        bad += mtrand_get(mt) != genrand_int32();
+    return bad != 0;
+}
+
+/* Jump by 2^log2n from a ragged offset and compare with stepping */
+static int checkjump(unsigned long seed, unsigned log2n, int offset)
+{
+    RAND_MT *mt = mtrand_new(seed);
+    unsigned long j;
+    int i, bad = 0;
+
+    init_genrand(seed);
+    for (i = 0; i < offset; i++)
+        bad += mtrand_get(mt) != genrand_int32();
+    if (mtrand_jump(mt, log2n) != 0) {
+        mtrand_dispose(mt);
+        return 1;
+    }
+    for (j = 0; j < 1UL << log2n; j++)
+        genrand_int32();
+    for (i = 0; i < CHECKLEN; i++)
+        bad += mtrand_get(mt) != genrand_int32();
+    mtrand_dispose(mt);
+    return bad != 0;
+}
+
+static int checksplit(unsigned long seed, unsigned log2n)
+{
+    RAND_MT *mt = mtrand_new(seed), *streams[4];
+    unsigned long j;
+    int i, s, bad = 0;
+
+    init_genrand(seed);
+    if (mtrand_split(mt, streams, 4, log2n) != 0) {
+        mtrand_dispose(mt);
+        return 1;
+    }
+    for (s = 0; s < 4; s++) {
+        for (j = 0; j < 1UL << log2n; j++)
+            bad += mtrand_get(streams[s]) != genrand_int32();
+        mtrand_dispose(streams[s]);
+    }
+    for (i = 0; i < CHECKLEN; i++)
+        bad += mtrand_get(mt) != genrand_int32();
+    mtrand_dispose(mt);
+    return bad != 0;
+}
+
+static int checkdouble(unsigned long seed)
+{
+    RAND_MT *mt = mtrand_new(seed);
+    int i, bad = 0;
+
+    init_genrand(seed);
+    for (i = 0; i < CHECKLEN; i++)
+        bad += mtrand_double(mt) != genrand_res53();
+    mtrand_dispose(mt);
+    return bad != 0;
+}
+
+static void conformance(int nseeds)
+{
+    int i, bad[8] = {0};
+
+    for (i = 0; i < nseeds; i++) {
+        unsigned long seed = testseed(i);
+
+        bad[0] += checkget(seed, RAND_MT_MODE_BLOCK);
+        bad[1] += checkget(seed, RAND_MT_MODE_SMOOTH);
+        bad[2] += checkfill(seed);
+        bad[3] += checkinplace(seed);
+        bad[4] += checkdouble(seed);
+    }
+    result("mtrand_get", nseeds, bad[0]);
+    result("mtrand_get_smooth", nseeds, bad[1]);
+    result("mtrand_fill", nseeds, bad[2]);
+    result("mtrand_init_inplace", nseeds, bad[3]);
+    result("mtrand_double", nseeds, bad[4]);
+
+    /* Jumps need the reference to step 2^log2n times, so fewer seeds */
+    for (i = 0; i < 8 && i < nseeds; i++) {
+        bad[5] += checkjump(testseed(i), 4 * i, i * 97);
+        bad[6] += checksplit(testseed(i), 2 * i + 4);
+    }
+    result("mtrand_jump", i, bad[5]);
+    result("mtrand_split", i, bad[6]);
+}
+
+/**********************************************************************
+ * Throughput
+ **********************************************************************/
+
+struct timing {
+    struct timespec ts;
+    uint64_t tsc;
+};
+
+static void timing_start(struct timing *t)
+{
+    clock_gettime(CLOCK_MONOTONIC, &t->ts);
+#ifdef HAVE_TSC
+    t->tsc = __rdtsc();
+#endif
+}
+
+static void timing_report(const struct timing *t0, const char *name,
+                          unsigned long long count, uint64_t sink)
+{
+    struct timespec ts;
+    double secs;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    secs = (ts.tv_sec - t0->ts.tv_sec) + (ts.tv_nsec - t0->ts.tv_nsec) * 1e-9;
+    printf("{\"suite\":\"throughput\",\"test\":\"%s\",\"count\":%llu,"
+           "\"seconds\":%.6f,\"numbers_per_sec\":%.0f,\"ns_per_number\":%.4f",
+           name, count, secs, count / secs, secs * 1e9 / count);
+#ifdef HAVE_TSC
+    printf(",\"tsc_per_number\":%.3f",
+           (double)(__rdtsc() - t0->tsc) / count);
+#endif
+    /* 'sink' keeps the generated numbers live */
+    printf(",\"sink\":%u}\n", (unsigned)(sink & 0xff));
+    fflush(stdout);
+}
+
+static void benchmt(unsigned long long count)
+{
+    static uint32_t buf[BLOCK];
+    static double dbuf[BLOCK];
+    static uint64_t buf64[BLOCK];
+    RAND_MT *mt = mtrand_new(5489);
+    RAND_MT64 *mt64 = mtrand64_new(5489);
+    RAND_SFMT *sfmt = sfmtrand_new(5489);
+    RAND_MTRING *ring = mtring_new(5489, 1, 1 << 20);
+    struct timing t;
+    unsigned long long i;
+    uint64_t sink = 0;
+
+    init_genrand(5489);
+    timing_start(&t);
+    for (i = 0; i < count; i++)
+        sink += genrand_int32();
+    timing_report(&t, "ref_genrand_int32", count, sink);
+
+    timing_start(&t);
+    for (i = 0; i < count; i++)
+        sink += mtrand_get(mt);
+    timing_report(&t, "mtrand_get", count, sink);
+
+    mtrand_setmode(mt, RAND_MT_MODE_SMOOTH);
+    timing_start(&t);
+    for (i = 0; i < count; i++)
+        sink += mtrand_get(mt);
+    timing_report(&t, "mtrand_get_smooth", count, sink);
+    mtrand_setmode(mt, RAND_MT_MODE_BLOCK);
+
+    timing_start(&t);
+    for (i = 0; i < count; i += BLOCK) {
+        mtrand_fill(mt, buf, BLOCK);
+        sink += buf[i & (BLOCK - 1)];
+    }
+    timing_report(&t, "mtrand_fill", i, sink);
+
+    timing_start(&t);
+    for (i = 0; i < count; i += BLOCK) {
+        mtrand_uniform_fill(mt, 1000, buf, BLOCK);
+        sink += buf[i & (BLOCK - 1)];
+    }
+    timing_report(&t, "mtrand_uniform_fill", i, sink);
+
+    timing_start(&t);
+    for (i = 0; i < count / 2; i += BLOCK) {
+        mtrand_double_fill(mt, dbuf, BLOCK);
+        sink += (uint64_t)(dbuf[i & (BLOCK - 1)] * 1000);
+    }
+    timing_report(&t, "mtrand_double_fill", i, sink);
+
+    timing_start(&t);
+    for (i = 0; i < count / 2; i += BLOCK) {
+        mtrand_normal_fill(mt, dbuf, BLOCK);
+        sink += (uint64_t)(dbuf[i & (BLOCK - 1)] * 1000);
+    }
+    timing_report(&t, "mtrand_normal_fill", i, sink);
+
+    timing_start(&t);
+    for (i = 0; i < count / 2; i += BLOCK) {
+        mtrand64_fill(mt64, buf64, BLOCK);
+        sink += buf64[i & (BLOCK - 1)];
+    }
+    timing_report(&t, "mtrand64_fill", i, sink);
+
+    timing_start(&t);
+    for (i = 0; i < count; i += BLOCK) {
+        sfmtrand_fill(sfmt, buf, BLOCK);
+        sink += buf[i & (BLOCK - 1)];
+    }
+    timing_report(&t, "sfmtrand_fill", i, sink);
+
+    /* Consumer side only; the generator runs on another thread */
+    if (ring) {
+        timing_start(&t);
+        for (i = 0; i < count; i += BLOCK) {
+            mtring_fill(ring, 0, buf, BLOCK);
+            sink += buf[i & (BLOCK - 1)];
+        }
+        timing_report(&t, "mtring_fill", i, sink);
+        mtring_dispose(ring);
+    }
+
+    sfmtrand_dispose(sfmt);
+    mtrand64_dispose(mt64);
+    mtrand_dispose(mt);
+}
+
+int main(int argc, char *argv[])
+{
+    int i, nseeds = DEFSEEDS, bench = 1;
+    unsigned long long count = DEFCOUNT;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seeds") && i + 1 < argc) {
+            nseeds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+            count = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--no-bench")) {
+            bench = 0;
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--seeds N] [--count N] [--no-bench]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    conformance(nseeds);
+    if (bench && count > 0)
+        benchmt(count);
+
+    return nfail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
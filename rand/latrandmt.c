@@ -0,0 +1,110 @@
+/*
+ * Per-call latency of mtrand_get() in RAND_MT_MODE_BLOCK and
+ * RAND_MT_MODE_SMOOTH.
+ *
+ * Every call is timed individually (rdtsc on x86, otherwise
+ * clock_gettime()) and the percentiles of the resulting distribution are
+ * reported. The timer overhead is measured the same way and is included in
+ * the figures.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "randmt.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <x86intrin.h>
+#   define TIMER_UNIT "cycles"
+static inline uint64_t timer_now(void)
+{
+    uint64_t t;
+
+    _mm_lfence();
+    t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+#else
+#   define TIMER_UNIT "ns"
+static inline uint64_t timer_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+#define NSAMPLES 2000000
+#define NWARMUP  100000
+
+static uint64_t samples[NSAMPLES];
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *name)
+{
+    qsort(samples, NSAMPLES, sizeof samples[0], cmp_u64);
+    printf("%-8s min %5lu  p50 %5lu  p99 %5lu  p999 %5lu  max %7lu %s\n",
+           name,
+           (unsigned long)samples[0],
+           (unsigned long)samples[NSAMPLES / 2],
+           (unsigned long)samples[(size_t)(NSAMPLES * 0.99)],
+           (unsigned long)samples[(size_t)(NSAMPLES * 0.999)],
+           (unsigned long)samples[NSAMPLES - 1],
+           TIMER_UNIT);
+}
+
+static void measure(RAND_MT *mt, int mode, const char *name)
+{
+    size_t i;
+    uint64_t t0, t1;
+    volatile unsigned long x;
+
+    mtrand_setmode(mt, mode);
+    for (i = 0; i < NWARMUP; i++)
+        x = mtrand_get(mt);
+
+    for (i = 0; i < NSAMPLES; i++) {
+        t0 = timer_now();
+        x = mtrand_get(mt);
+        t1 = timer_now();
+        samples[i] = t1 - t0;
+    }
+    (void)x;
+    report(name);
+}
+
+int main(void)
+{
+    RAND_MT *mt;
+    size_t i;
+    uint64_t t0, t1;
+
+    mt = mtrand_new(10);
+    if (!mt) {
+        fputs("Could not initialise RNG. Aborting.", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%d calls per mode\n", NSAMPLES);
+
+    for (i = 0; i < NSAMPLES; i++) {
+        t0 = timer_now();
+        t1 = timer_now();
+        samples[i] = t1 - t0;
+    }
+    report("overhead");
+
+    measure(mt, RAND_MT_MODE_BLOCK, "block");
+    measure(mt, RAND_MT_MODE_SMOOTH, "smooth");
+
+    mtrand_dispose(mt);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+/*
+ * Background-refilled ring buffers of Mersenne Twister output
+ *
+ * License: BSD-3
+ */
+
+/*
+ * Each ring is a classic lock-free SPSC queue: the generator thread only
+ * writes 'head' and the consumer only writes 'tail'; both are free-running
+ * counters and the slot is counter & mask. The two counters live on
+ * separate cache lines so producer and consumer do not false-share.
+ *
+ * Requires C11 atomics and POSIX threads.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "mtring.h"
+#include "randmt.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+/**********************************************************************
+ * Private
+ **********************************************************************/
+
+#define MTRING_CACHELINE    64
+
+/* The generator sleeps this long when every ring is (nearly) full */
+#define MTRING_IDLENS       20000
+
+struct ring {
+    /* Written by the generator thread */
+    _Alignas(MTRING_CACHELINE)
+    atomic_size_t       head;
+    RAND_MT            *mt;
+
+    /* Written by the consumer */
+    _Alignas(MTRING_CACHELINE)
+    atomic_size_t       tail;
+    atomic_ullong       underruns;
+
+    _Alignas(MTRING_CACHELINE)
+    uint32_t           *buf;
+    size_t              mask;
+};
+
+struct mtring {
+    struct ring        *rings;
+    int                 nrings;
+    size_t              chunk;      /* Refill when at least this much room */
+    atomic_int          stop;
+    pthread_t           thread;
+};
+
+/* Top up one ring. Returns non-zero if anything was written */
+static int
+mtring_refill_(struct ring *rg, size_t chunk)
+{
+    size_t head, room, slot, n;
+
+    head = atomic_load_explicit(&rg->head, memory_order_relaxed);
+    room = rg->mask + 1 - (head - atomic_load_explicit(&rg->tail,
+                                                       memory_order_acquire));
+    if (room < chunk)
+        return 0;
+
+    while (room > 0) {
+        /* Contiguous run up to the end of the buffer */
+        slot = head & rg->mask;
+        n = rg->mask + 1 - slot;
+        if (n > room)
+            n = room;
+        mtrand_fill(rg->mt, rg->buf + slot, n);
+        head += n;
+        room -= n;
+        atomic_store_explicit(&rg->head, head, memory_order_release);
+    }
+    return 1;
+}
+
+static void *
+mtring_thread_(void *arg)
+{
+    struct mtring *r = arg;
+    const struct timespec idle = { 0, MTRING_IDLENS };
+    int i, busy;
+
+    while (!atomic_load_explicit(&r->stop, memory_order_relaxed)) {
+        busy = 0;
+        for (i = 0; i < r->nrings; i++)
+            busy |= mtring_refill_(&r->rings[i], r->chunk);
+        if (!busy)
+            nanosleep(&idle, NULL);
+    }
+    return NULL;
+}
+
+/* Wait until the ring has data; returns the number of readable entries */
+inline static size_t
+mtring_wait_(struct ring *rg, size_t tail)
+{
+    size_t avail;
+
+    avail = atomic_load_explicit(&rg->head, memory_order_acquire) - tail;
+    if (avail == 0) {
+        atomic_fetch_add_explicit(&rg->underruns, 1, memory_order_relaxed);
+        do {
+            sched_yield();
+            avail = atomic_load_explicit(&rg->head, memory_order_acquire)
+                    - tail;
+        } while (avail == 0);
+    }
+    return avail;
+}
+
+static void
+mtring_free_(struct mtring *r)
+{
+    int i;
+
+    for (i = 0; i < r->nrings; i++) {
+        free(r->rings[i].buf);
+        if (r->rings[i].mt)
+            mtrand_dispose(r->rings[i].mt);
+    }
+    free(r->rings);
+    free(r);
+}
+
+/**********************************************************************
+ * Public
+ **********************************************************************/
+
+RAND_MTRING *
+mtring_new(unsigned long seed, int nconsumers, size_t capacity)
+{
+    struct mtring *r;
+    RAND_MT *master, **streams;
+    size_t cap;
+    int i;
+
+    if (nconsumers < 1 || capacity < 1)
+        return NULL;
+    for (cap = 1; cap < capacity; cap <<= 1)
+        ;
+
+    if ((r = calloc(1, sizeof *r)) == NULL)
+        return NULL;
+    r->rings = aligned_alloc(MTRING_CACHELINE, nconsumers * sizeof *r->rings);
+    streams = malloc(nconsumers * sizeof *streams);
+    master = mtrand_new(seed);
+    if (r->rings == NULL || streams == NULL || master == NULL
+            || mtrand_split(master, streams, nconsumers,
+                            RAND_MTRING_STREAMLOG2) != 0) {
+        free(streams);
+        if (master)
+            mtrand_dispose(master);
+        free(r->rings);
+        free(r);
+        return NULL;
+    }
+    mtrand_dispose(master);
+
+    r->nrings = nconsumers;
+    r->chunk = cap / 4 ? cap / 4 : 1;
+    for (i = 0; i < nconsumers; i++) {
+        struct ring *rg = &r->rings[i];
+
+        atomic_init(&rg->head, 0);
+        atomic_init(&rg->tail, 0);
+        atomic_init(&rg->underruns, 0);
+        rg->mt = streams[i];
+        rg->mask = cap - 1;
+        rg->buf = malloc(cap * sizeof *rg->buf);
+    }
+    free(streams);
+    for (i = 0; i < nconsumers; i++) {
+        if (r->rings[i].buf == NULL) {
+            mtring_free_(r);
+            return NULL;
+        }
+        mtring_refill_(&r->rings[i], 1);
+    }
+
+    atomic_init(&r->stop, 0);
+    if (pthread_create(&r->thread, NULL, mtring_thread_, r) != 0) {
+        mtring_free_(r);
+        return NULL;
+    }
+    return r;
+}
+
+void
+mtring_dispose(RAND_MTRING *r)
+{
+    atomic_store(&r->stop, 1);
+    pthread_join(r->thread, NULL);
+    mtring_free_(r);
+}
+
+unsigned long
+mtring_get(RAND_MTRING *r, int consumer)
+{
+    struct ring *rg = &r->rings[consumer];
+    size_t tail;
+    uint32_t y;
+
+    tail = atomic_load_explicit(&rg->tail, memory_order_relaxed);
+    mtring_wait_(rg, tail);
+    y = rg->buf[tail & rg->mask];
+    atomic_store_explicit(&rg->tail, tail + 1, memory_order_release);
+    return y;
+}
+
+void
+mtring_fill(RAND_MTRING *r, int consumer, uint32_t *buf, size_t n)
+{
+    struct ring *rg = &r->rings[consumer];
+    size_t tail, avail, slot, k, i;
+
+    tail = atomic_load_explicit(&rg->tail, memory_order_relaxed);
+    while (n > 0) {
+        avail = mtring_wait_(rg, tail);
+        slot = tail & rg->mask;
+        k = rg->mask + 1 - slot;
+        if (k > avail)
+            k = avail;
+        if (k > n)
+            k = n;
+        for (i = 0; i < k; i++)
+            buf[i] = rg->buf[slot + i];
+        buf += k;
+        n -= k;
+        tail += k;
+        atomic_store_explicit(&rg->tail, tail, memory_order_release);
+    }
+}
+
+void
+mtring_stats(RAND_MTRING *r, int consumer, struct mtring_stats *st)
+{
+    struct ring *rg = &r->rings[consumer];
+
+    st->produced = atomic_load(&rg->head);
+    st->consumed = atomic_load(&rg->tail);
+    st->underruns = atomic_load(&rg->underruns);
+}
@@ -0,0 +1,55 @@
+/*
+ * Background-refilled ring buffers of Mersenne Twister output
+ *
+ * A generator thread keeps one single-producer/single-consumer ring per
+ * consumer topped up with tempered RAND_MT output, so consumers only read
+ * memory. Each consumer's numbers come from its own stream (see
+ * mtrand_split()), so what a consumer sees depends only on the seed and its
+ * index; not on timing.
+ *
+ * License: BSD-3
+ */
+
+#ifndef Z_RAND_MTRING
+#define Z_RAND_MTRING
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Distance between consumer streams, as log2 of the count of numbers */
+#define RAND_MTRING_STREAMLOG2 64
+
+typedef struct mtring RAND_MTRING;
+
+struct mtring_stats {
+    unsigned long long  produced;   /* Numbers written to the ring */
+    unsigned long long  consumed;   /* Numbers read from the ring */
+    unsigned long long  underruns;  /* Reads that found the ring empty */
+};
+
+/* Create rings for 'nconsumers' consumers, each holding up to 'capacity'
+ * numbers (rounded up to a power of 2) and start the generator thread.
+ * Returns NULL on failure.
+ */
+RAND_MTRING *mtring_new(unsigned long seed, int nconsumers, size_t capacity);
+
+/* Stop the generator thread and free all resources. No consumer may be
+ * using the rings.
+ */
+void mtring_dispose(RAND_MTRING *r);
+
+/* Get a random number for 'consumer' (0 .. nconsumers - 1). Only one thread
+ * may read a given consumer's ring. If the ring is empty the call waits for
+ * the generator and counts an underrun.
+ */
+unsigned long mtring_get(RAND_MTRING *r, int consumer);
+
+/* Read 'n' random numbers for 'consumer' into 'buf'. An underrun is counted
+ * each time the ring runs empty before 'n' numbers have been read.
+ */
+void mtring_fill(RAND_MTRING *r, int consumer, uint32_t *buf, size_t n);
+
+/* Counters for 'consumer'; e.g. to size 'capacity' */
+void mtring_stats(RAND_MTRING *r, int consumer, struct mtring_stats *st);
+
+#endif /* Z_RAND_MTRING */
@@ -0,0 +1,329 @@
+/*
+ * Distributions on top of RAND_MT
+ * 
+ * License: BSD-3
+ */
+
+/* 
+ * References: 
+ * D. Lemire, "Fast Random Integer Generation in an Interval", ACM TOMACS
+ *     29(1), 2019
+ * G. Marsaglia, W. W. Tsang, "The Ziggurat Method for Generating Random
+ *     Variables", Journal of Statistical Software 5(8), 2000
+ * J. A. Doornik, "An Improved Ziggurat Method to Generate Normal Random
+ *     Samples", 2005 (ZIGNOR; the variant implemented here)
+ */
+
+#include "randdist.h"
+#include <math.h>
+
+/**********************************************************************
+ * Private
+ **********************************************************************/
+
+/* Numbers drawn per block by the _fill() functions */
+#define DIST_BLOCK          512
+
+#define DIST_2POW26         67108864.0
+#define DIST_2POWM53        (1.0 / 9007199254740992.0)
+
+/* 128-layer ziggurat: R is the start of the tail, V the area of each layer.
+ * zig_x[i] is the right edge of layer i (zig_x[0] = V / f(R) for the base
+ * layer, which includes the tail) and zig_r[i] = zig_x[i + 1] / zig_x[i]
+ * is the fraction of layer i that lies entirely under the curve.
+ */
+#define ZIG_LAYERS          128
+#define ZIG_LAYERMASK       (ZIG_LAYERS - 1)
+#define ZIG_R               3.442619855899
+
+static const double zig_x[ZIG_LAYERS + 1] = {
+    3.7130862467425505, 3.4426198558990002, 3.2230849845811416,
+    3.0832288582168683, 2.9786962526477803, 2.8943440070215289,
+    2.8231253505489105, 2.7611693723871769, 2.7061135731218195,
+    2.6564064112613597, 2.6109722484318474, 2.5690336259249378,
+    2.5300096723888275, 2.4934545220953721, 2.4590181774118305,
+    2.4264206455337498, 2.3954342780110625, 2.3658713701176386,
+    2.3375752413392368, 2.310413683698763, 2.2842740596774718,
+    2.2590595738691985, 2.2346863955909795, 2.2110814088787034,
+    2.1881804320760492, 2.1659267937489219, 2.1442701823603953,
+    2.1231657086739766, 2.1025731351892385, 2.0824562379920168,
+    2.0627822745083084, 2.0435215366550676, 2.0246469733773855,
+    2.0061338699634721, 1.9879595741276199, 1.9701032608543265,
+    1.9525457295535567, 1.9352692282966228, 1.9182573008645099,
+    1.9014946531051511, 1.884967035707759, 1.8686611409944887,
+    1.8525645117280911, 1.836665460258446, 1.8209529965961255,
+    1.8054167642192285, 1.7900469825998586, 1.7748343955860695,
+    1.7597702248995934, 1.7448461281138004, 1.7300541605637305,
+    1.7153867407136676, 1.7008366185699169, 1.6863968467791681,
+    1.6720607540976009, 1.6578219209540241, 1.6436741568628686,
+    1.6296114794706347, 1.615628095043161, 1.6017183802213781,
+    1.5878768648905761, 1.5740982160230008, 1.5603772223661689,
+    1.5467087798599104, 1.5330878776740433, 1.5195095847659401,
+    1.5059690368632033, 1.492461423781354, 1.4789819769899242,
+    1.4655259573427108, 1.4520886428892246, 1.4386653166845635,
+    1.4252512545140601, 1.4118417124470577, 1.3984319141310053,
+    1.3850170377326518, 1.3715922024273426, 1.3581524543301435,
+    1.344692751753547, 1.3312079496656273, 1.3176927832094141,
+    1.3041418501286168, 1.2905495919261964, 1.2769102735601556,
+    1.2632179614546211, 1.2494664995730682, 1.2356494832633627,
+    1.2217602305399964, 1.2077917504159497, 1.1937367078331287,
+    1.1795873846639882, 1.1653356361647524, 1.1509728421488674,
+    1.1364898520131608, 1.1218769225825422, 1.107123647534036,
+    1.0922188769072774, 1.0771506248928957, 1.0619059636948243,
+    1.0464709007640454, 1.0308302360681956, 1.0149673952513305,
+    0.99886423349298359, 0.98250080351542901, 0.9658550794011499,
+    0.94890262551130644, 0.93161619661515083, 0.91396525102303228,
+    0.89591535258093769, 0.87742742911292337, 0.85845684319381321,
+    0.83895221429757738, 0.81885390670035729, 0.79809206064405691,
+    0.77658398789475991, 0.75423066445405562, 0.73091191064248884,
+    0.70647961133543646, 0.68074791866915463, 0.65347863873997525,
+    0.6243585973360507, 0.59296294247144832, 0.55869217840818519,
+    0.52065603876206057, 0.47743783729668982, 0.42654798635542351,
+    0.36287143109703196, 0.27232086481396467, 0
+};
+
+static const double zig_r[ZIG_LAYERS] = {
+    0.92715860260966809, 0.93623028957388921, 0.95660799295292287,
+    0.96609638454488822, 0.97168148798278098, 0.97539385218210217,
+    0.97805411716851776, 0.98006069464048895, 0.98163153152396454,
+    0.98289638112718658, 0.98393754566633251, 0.98480987047335344,
+    0.98555137923289438, 0.98618930308197361, 0.98674367998678636,
+    0.98722959781119435, 0.98765864371032963, 0.98803987015701755,
+    0.98838045631210891, 0.98868617156930783, 0.98896170724285448,
+    0.98921091831302443, 0.98943700254369094, 0.98964263517811046,
+    0.98983007159696879, 0.99000122651835243, 0.99015773578346966,
+    0.99030100505080254, 0.99043224853369438, 0.99055252008432182,
+    0.99066273833585672, 0.99076370718921958, 0.99085613262097194,
+    0.99094063656071807, 0.99101776841657896, 0.99108801469971874,
+    0.99115180710216499, 0.99120952930818496, 0.99126152276245516,
+    0.99130809157396138, 0.99134950669991539, 0.99138600952667588,
+    0.9914178149430195, 0.99144511398384472, 0.99146807610853294,
+    0.99148685116701207, 0.99150157109748349, 0.9915123513923666,
+    0.99151929236293068, 0.99152248022806455, 0.99152198804846459,
+    0.99151787652404422, 0.99151019466943868, 0.99149898038000517,
+    0.99148426089860509, 0.9914660531916395, 0.99144436424122284,
+    0.99141919125900113, 0.99139052182587151, 0.99135833396074968,
+    0.99132259612049656, 0.99128326713214987, 0.9912402960576856,
+    0.991193621990624, 0.99114317378289896, 0.99108886969948096,
+    0.99103061699728945, 0.99096831142390407, 0.99090183663049125,
+    0.99083106349214667, 0.9907558493275227, 0.99067603700809548,
+    0.99059145394572945, 0.99050191094523621, 0.99040720090638834,
+    0.99030709735723799, 0.99020135279756305, 0.99008969682771364,
+    0.98997183403395694, 0.98984744159647786, 0.98971616658035255,
+    0.98957762286281981, 0.98943138764184679, 0.98927699746094222,
+    0.98911394367309524, 0.9889416672520418, 0.98875955284124373,
+    0.98856692190915973, 0.98836302485260341, 0.98814703185694575,
+    0.98791802228090508, 0.98767497228253098, 0.98741674033883642,
+    0.98714205023059953, 0.98684947096108866, 0.98653739294616549,
+    0.98620399964423899, 0.98584723357553894, 0.98546475539408995,
+    0.98505389429899071, 0.98461158757103473, 0.98413430634945731,
+    0.98361796385447464, 0.98305780101683371, 0.98244824275257281,
+    0.98178271570611264, 0.98105341485447561, 0.98025100142276667,
+    0.97936420732745055, 0.97837931059633121, 0.97727942988529215,
+    0.97604356093863154, 0.97464523783007639, 0.97305063687522453,
+    0.97121583268629852, 0.9690827290502092, 0.96657285378538182,
+    0.96357758631187951, 0.95994217656590097, 0.95543841882869618,
+    0.94971534788091627, 0.9422042060159378, 0.93191932674895062,
+    0.91699279707169312, 0.89341051972459762, 0.85071654937943442,
+    0.75046102138899429, 0
+};
+
+inline static uint32_t
+dist_lemire_(uint32_t x, uint32_t bound, uint32_t *lo)
+{
+    uint64_t m = (uint64_t)x * bound;
+    
+    *lo = (uint32_t)m;
+    return (uint32_t)(m >> 32);
+}
+
+inline static double
+dist_res53_(uint32_t a, uint32_t b)
+{
+    return ((a >> 5) * DIST_2POW26 + (b >> 6)) * DIST_2POWM53;
+}
+
+/* Uniform in (0, 1) for the logarithms in the ziggurat slow path */
+inline static double
+dist_open53_(RAND_MT *mt)
+{
+    uint32_t a = mtrand_get(mt), b = mtrand_get(mt);
+    
+    return (((a >> 5) * DIST_2POW26 + (b >> 6)) + 0.5) * DIST_2POWM53;
+}
+
+/* Candidate from a pair of numbers: 53 bits for u in [-1, 1) and the low 7
+ * bits of b (which the 53 bits do not use) for the layer
+ */
+inline static double
+dist_zigu_(uint32_t a, uint32_t b)
+{
+    return 2.0 * (((b >> 11) * 4294967296.0 + a) * DIST_2POWM53) - 1.0;
+}
+
+static double
+dist_normaltail_(RAND_MT *mt, int negative)
+{
+    double x, y;
+    
+    do {
+        x = log(dist_open53_(mt)) / ZIG_R;
+        y = log(dist_open53_(mt));
+    } while (-2 * y < x * x);
+    return negative ? x - ZIG_R : ZIG_R - x;
+}
+
+/* The candidate u (in layer i) fell outside the rectangle wholly under the
+ * curve. Accept it if it is under the curve, else draw again.
+ */
+static double
+dist_normalslow_(RAND_MT *mt, double u, unsigned i)
+{
+    double x, f0, f1;
+    
+    for (;;) {
+        if (i == 0)
+            return dist_normaltail_(mt, u < 0);
+        
+        x = u * zig_x[i];
+        f0 = exp(-0.5 * (zig_x[i] * zig_x[i] - x * x));
+        f1 = exp(-0.5 * (zig_x[i + 1] * zig_x[i + 1] - x * x));
+        if (f1 + mtrand_double(mt) * (f0 - f1) < 1.0)
+            return x;
+        
+        /* New candidate */
+        {
+            uint32_t a = mtrand_get(mt), b = mtrand_get(mt);
+            
+            u = dist_zigu_(a, b);
+            i = b & ZIG_LAYERMASK;
+            if (fabs(u) < zig_r[i])
+                return u * zig_x[i];
+        }
+    }
+}
+
+/**********************************************************************
+ * Public
+ **********************************************************************/
+
+uint32_t
+mtrand_uniform(RAND_MT *mt, uint32_t bound)
+{
+    uint32_t r, lo, t;
+    
+    if (bound == 0)
+        return mtrand_get(mt);
+    
+    r = dist_lemire_(mtrand_get(mt), bound, &lo);
+    if (lo < bound) {
+        t = -bound % bound;     /* 2^32 mod bound */
+        while (lo < t)
+            r = dist_lemire_(mtrand_get(mt), bound, &lo);
+    }
+    return r;
+}
+
+double
+mtrand_double(RAND_MT *mt)
+{
+    uint32_t a = mtrand_get(mt);
+    
+    return dist_res53_(a, mtrand_get(mt));
+}
+
+double
+mtrand_normal(RAND_MT *mt)
+{
+    uint32_t a = mtrand_get(mt), b = mtrand_get(mt);
+    unsigned i = b & ZIG_LAYERMASK;
+    double u = dist_zigu_(a, b);
+    
+    if (fabs(u) < zig_r[i])
+        return u * zig_x[i];
+    return dist_normalslow_(mt, u, i);
+}
+
+/* The _fill() functions work a block at a time: one straight-line loop over
+ * the block (which the compiler can vectorise) computes every result and
+ * notes whether any of them needs the slow path, and a second loop only
+ * runs for the (rare) blocks that do.
+ */
+
+void
+mtrand_uniform_fill(RAND_MT *mt, uint32_t bound, uint32_t *buf, size_t n)
+{
+    uint32_t lo[DIST_BLOCK], t;
+    size_t i, k;
+    int retry;
+    
+    if (bound == 0) {
+        mtrand_fill(mt, buf, n);
+        return;
+    }
+    
+    t = -bound % bound;
+    for (; n > 0; n -= k, buf += k) {
+        k = n < DIST_BLOCK ? n : DIST_BLOCK;
+        mtrand_fill(mt, buf, k);
+        
+        retry = 0;
+        for (i = 0; i < k; i++) {
+            uint64_t m = (uint64_t)buf[i] * bound;
+            
+            buf[i] = (uint32_t)(m >> 32);
+            lo[i] = (uint32_t)m;
+            retry |= lo[i] < t;
+        }
+        
+        if (retry)
+            for (i = 0; i < k; i++)
+                while (lo[i] < t)
+                    buf[i] = dist_lemire_(mtrand_get(mt), bound, &lo[i]);
+    }
+}
+
+void
+mtrand_double_fill(RAND_MT *mt, double *buf, size_t n)
+{
+    uint32_t raw[2 * DIST_BLOCK];
+    size_t i, k;
+    
+    for (; n > 0; n -= k, buf += k) {
+        k = n < DIST_BLOCK ? n : DIST_BLOCK;
+        mtrand_fill(mt, raw, 2 * k);
+        for (i = 0; i < k; i++)
+            buf[i] = dist_res53_(raw[2 * i], raw[2 * i + 1]);
+    }
+}
+
+void
+mtrand_normal_fill(RAND_MT *mt, double *buf, size_t n)
+{
+    uint32_t raw[2 * DIST_BLOCK];
+    double u[DIST_BLOCK];
+    size_t i, k;
+    int slow;
+    
+    for (; n > 0; n -= k, buf += k) {
+        k = n < DIST_BLOCK ? n : DIST_BLOCK;
+        mtrand_fill(mt, raw, 2 * k);
+        
+        slow = 0;
+        for (i = 0; i < k; i++) {
+            unsigned l = raw[2 * i + 1] & ZIG_LAYERMASK;
+            
+            u[i] = dist_zigu_(raw[2 * i], raw[2 * i + 1]);
+            buf[i] = u[i] * zig_x[l];
+            slow |= !(fabs(u[i]) < zig_r[l]);
+        }
+        
+        if (slow)
+            for (i = 0; i < k; i++) {
+                unsigned l = raw[2 * i + 1] & ZIG_LAYERMASK;
+                
+                if (!(fabs(u[i]) < zig_r[l]))
+                    buf[i] = dist_normalslow_(mt, u[i], l);
+            }
+    }
+}
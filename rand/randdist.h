@@ -0,0 +1,39 @@
+/*
+ * Distributions on top of RAND_MT
+ *
+ * License: BSD-3
+ */
+
+#ifndef Z_RAND_DIST
+#define Z_RAND_DIST
+
+#include <stddef.h>
+#include <stdint.h>
+#include "randmt.h"
+
+/* Unbiased random integer in [0, bound) using Lemire's multiply-shift
+ * method. A bound of 0 gives the full 32-bit range.
+ */
+uint32_t mtrand_uniform(RAND_MT *mt, uint32_t bound);
+
+/* Random double in [0, 1) with 53-bit resolution, built from two numbers
+ * (the same as genrand_res53() in the reference implementation)
+ */
+double mtrand_double(RAND_MT *mt);
+
+/* Standard normal deviate (mean 0, standard deviation 1) using the
+ * ziggurat method
+ */
+double mtrand_normal(RAND_MT *mt);
+
+/* Bulk versions of the above, writing 'n' values to 'buf'. They draw the
+ * underlying numbers in blocks so the results (and the number of values
+ * taken from mt) are not necessarily the same as 'n' single calls, except
+ * for mtrand_double_fill() which always matches.
+ */
+void mtrand_uniform_fill(RAND_MT *mt, uint32_t bound, uint32_t *buf,
+                         size_t n);
+void mtrand_double_fill(RAND_MT *mt, double *buf, size_t n);
+void mtrand_normal_fill(RAND_MT *mt, double *buf, size_t n);
+
+#endif /* Z_RAND_DIST */
@@ -16,7 +16,20 @@
 
 #include "randmt.h"
 #include <stdlib.h>
-#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+/* SIMD state regeneration is only attempted on x86 with a compiler that
+ * supports per-function target attributes and runtime CPU detection
+ * (gcc, clang). Define MT_NO_SIMD to force the portable scalar path.
+ */
+#if !defined(MT_NO_SIMD) && defined(__GNUC__) \
+        && (defined(__x86_64__) || defined(__i386__))
+#   define MT_HAVE_X86SIMD
+#   include <immintrin.h>
+#endif
 
 /**********************************************************************
  * Private
@@ -43,38 +56,60 @@
 #define MT_BITS0TO30        0x7FFFFFFFUL
 #define MT_MASK32           0xFFFFFFFFUL
 
-/* The question remains whether or not using unsinged long is faster than
- * using uint32_t. If, for example, a 64-bit machine has to shift unaligned
- * uint32_t values (to align them) then perhaps using unsigned long is better.
- * Because the question remains unanswered I am leaving everything as unsigned
- * long for now
+/* Degree of the characteristic polynomial (the Mersenne exponent) and the
+ * number of 64-bit words needed to hold a polynomial of that degree
  */
-#if ULONG_MAX >> 32
-#   define MASKRESULT(d,s) ( (d) = (s) & MT_MASK32 )
-#else
-#   define MASKRESULT(d,s) (void)(0)
-#endif
+#define MT_MEXP             19937
+#define MT_PWORDS           ((MT_MEXP + 64) / 64)
 
+/* The state is stored as uint32_t rather than unsigned long. On x86-64
+ * (LP64) this halves the size of struct mt to 2.5 KB and was not slower in
+ * any path. Measured ns/number (unsigned long -> uint32_t):
+ * 
+ *                       scalar          AVX2
+ *      mtrand_get()     ~5.0 -> ~5.0    ~4.3 -> ~4.2  (within noise)
+ *      mtrand_fill()    ~3.4 -> ~2.8    ~1.0 -> ~0.6
+ * 
+ * 32-bit loads need no realignment, twice as many words fit in a vector and
+ * results no longer have to be masked to 32 bits.
+ */
+/* Note: In RAND_MT_MODE_SMOOTH idx runs from MT_UTNLEN to 2 * MT_UTNLEN - 1
+ *       and idx - MT_UTNLEN is the position of the next word to regenerate
+ *       (utn[] is then circular). Values below MT_UTNLEN have the usual
+ *       meaning in both modes; i.e. words already regenerated in bulk that
+ *       have not yet been output.
+ */
 struct mt {
-    unsigned long   utn[MT_UTNLEN];
+    uint32_t        utn[MT_UTNLEN];
     int             idx;
+    int             mode;
+};
+
+/* Note: Checks that RAND_MT_SIZE and RAND_MT_ALIGN in randmt.h are correct
+ *       (the array size is negative, and so a compile error, if not)
+ */
+struct mt_alignprobe_ {
+    char        c;
+    struct mt   mt;
 };
+typedef char mt_checksize_[sizeof(struct mt) == RAND_MT_SIZE ? 1 : -1];
+typedef char mt_checkalign_[
+        offsetof(struct mt_alignprobe_, mt) <= RAND_MT_ALIGN ? 1 : -1];
 
 inline static void mt_gen_(struct mt *mt);
+static void mt_selectimpl_(void);
 
-inline static unsigned long 
-knuth_prng(unsigned long pn, unsigned long n)
+inline static uint32_t 
+knuth_prng(uint32_t pn, uint32_t n)
 {
-    unsigned nrn = KNUTH_MULTIPLIER * (pn ^ (pn >> KNUTH_SHIFT)) + n;
-    MASKRESULT(nrn, nrn);
-    return nrn;
+    return KNUTH_MULTIPLIER * (pn ^ (pn >> KNUTH_SHIFT)) + n;
 }
 
 inline static void 
 mt_init_(struct mt *mt, unsigned long seed)
 {
     int i;
-    unsigned long *utn = mt->utn;
+    uint32_t *utn = mt->utn;
     
     utn[0] = seed & MT_MASK32;
     for (i = 1; i < MT_UTNLEN; i++)
@@ -84,26 +119,68 @@ mt_init_(struct mt *mt, unsigned long seed)
      * triggers a call to mt_gen_()
      */
     mt->idx = i;
+    mt->mode = RAND_MT_MODE_BLOCK;
 }
 
-inline static unsigned long
-mt_combinebits_(unsigned long a, unsigned long b)
+inline static uint32_t
+mt_combinebits_(uint32_t a, uint32_t b)
 {
     return (a & MT_BIT31) | (b & MT_BITS0TO30);
 }
 
-inline static unsigned long
-mt_matrixmultiply_(unsigned long a, unsigned long b)
+/* Note: -(b & 1) is all ones when the low bit of b is set, so masking
+ *       MT_MATRIX with it replaces the reference algorithm's mag01[] table
+ *       lookup with straight-line arithmetic (and is the form used by the
+ *       SIMD paths below)
+ */
+inline static uint32_t
+mt_matrixmultiply_(uint32_t a, uint32_t b)
 {
-    static unsigned long magic[2] = {0UL, MT_MATRIX};
-    return a ^ (b >> 1) ^ magic[b & 0x01];
+    return a ^ (b >> 1) ^ (-(b & 0x01) & MT_MATRIX);
 }
 
-inline static void 
-mt_gen_(struct mt *mt)
+inline static uint32_t
+mt_temper_(uint32_t y)
+{
+    y ^= (y >> MT_SHIFTA);
+    y ^= (y << MT_SHIFTB) & MT_MAGICMASKA;
+    y ^= (y << MT_SHIFTC) & MT_MAGICMASKB;
+    y ^= (y >> MT_SHIFTD);
+    
+    return y;
+}
+
+/* Regenerate utn[i] for i in [from, to). 'off' is the distance to the word
+ * that is mixed in; i.e. MT_MAGICN for the first 227 words and
+ * MT_MAGICN - MT_UTNLEN for the remainder (which reads words already
+ * regenerated during this pass)
+ */
+inline static void
+mt_genrange_(uint32_t *utn, int from, int to, int off)
 {
     int i;
-    unsigned long *utn = mt->utn, y;    
+    uint32_t y;
+    
+    for (i = from; i < to; i++) {
+        y = mt_combinebits_(utn[i], utn[i + 1]);
+        utn[i] = mt_matrixmultiply_(utn[i + off], y);
+    }
+}
+
+/* The last word wraps around to utn[0] */
+inline static void
+mt_genlast_(uint32_t *utn)
+{
+    uint32_t y;
+    
+    y = mt_combinebits_(utn[MT_UTNLEN - 1], utn[0]);
+    utn[MT_UTNLEN - 1] = mt_matrixmultiply_(utn[MT_MAGICN - 1], y);
+}
+
+static void 
+mt_gen_scalar_(struct mt *mt)
+{
+    uint32_t *utn = mt->utn;
     
     /* Note: The "reference algorithm" checks if mt_init_() has been called and
      *       if not calls mt_init_() with a seed of 5489UL. Because of the
@@ -111,36 +188,534 @@ mt_gen_(struct mt *mt)
      *       mt_init_() to have not been called because it gets called by
      *       mtrand_new() which creates the user program MT object
      */
-        
-    for (i = 0; i < MT_UTNLEN - MT_MAGICN; i++) {
-        y = mt_combinebits_(utn[i], utn[i + 1]);
-        utn[i] = mt_matrixmultiply_(utn[i + MT_MAGICN], y);
+    
+    mt_genrange_(utn, 0, MT_UTNLEN - MT_MAGICN, MT_MAGICN);
+    mt_genrange_(utn, MT_UTNLEN - MT_MAGICN, MT_UTNLEN - 1,
+                 MT_MAGICN - MT_UTNLEN);
+    mt_genlast_(utn);
+    
+    mt->idx = 0;
+}
+
+static void
+mt_temper_scalar_(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    size_t i;
+    
+    for (i = 0; i < n; i++)
+        dst[i] = mt_temper_(src[i]);
+}
+
+#ifdef MT_HAVE_X86SIMD
+
+/* Each word only depends on the (old) word after it and on a word
+ * MT_MAGICN ahead (old) or MT_UTNLEN - MT_MAGICN = 227 behind (already
+ * regenerated), so any run of up to 227 consecutive words can be computed
+ * in parallel. The vector loops below process 128/256 bits at a time and
+ * leave the ragged ends to mt_genrange_().
+ * 
+ * Tempering has no dependencies at all and is done four (SSE2) or eight
+ * (AVX2) words at a time by mtrand_fill().
+ */
+#define MT_SSE2LANES            4
+#define MT_AVX2LANES            8
+#define mt_sse2set1_(x)         _mm_set1_epi32((int)(x))
+#define mt_avx2set1_(x)         _mm256_set1_epi32((int)(x))
+
+__attribute__((target("sse2")))
+static int
+mt_genvec_sse2_(uint32_t *utn, int from, int to, int off)
+{
+    const __m128i upper = mt_sse2set1_(MT_BIT31);
+    const __m128i lower = mt_sse2set1_(MT_BITS0TO30);
+    const __m128i one = mt_sse2set1_(1);
+    const __m128i matrix = mt_sse2set1_(MT_MATRIX);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a, b, c, y;
+    int i;
+    
+    for (i = from; i + MT_SSE2LANES <= to; i += MT_SSE2LANES) {
+        a = _mm_loadu_si128((const __m128i *)&utn[i]);
+        b = _mm_loadu_si128((const __m128i *)&utn[i + 1]);
+        c = _mm_loadu_si128((const __m128i *)&utn[i + off]);
+        y = _mm_or_si128(_mm_and_si128(a, upper), _mm_and_si128(b, lower));
+        c = _mm_xor_si128(c, _mm_srli_epi32(y, 1));
+        y = _mm_and_si128(_mm_sub_epi32(zero, _mm_and_si128(y, one)), matrix);
+        _mm_storeu_si128((__m128i *)&utn[i], _mm_xor_si128(c, y));
     }
-    for (; i < MT_UTNLEN - 1; i++) {
-        y = mt_combinebits_(utn[i], utn[i + 1]);
-        utn[i] = mt_matrixmultiply_(utn[i + MT_MAGICN - MT_UTNLEN], y);
+    return i;
+}
+
+__attribute__((target("sse2")))
+static void
+mt_gen_sse2_(struct mt *mt)
+{
+    uint32_t *utn = mt->utn;
+    int i;
+    
+    i = mt_genvec_sse2_(utn, 0, MT_UTNLEN - MT_MAGICN, MT_MAGICN);
+    mt_genrange_(utn, i, MT_UTNLEN - MT_MAGICN, MT_MAGICN);
+    i = mt_genvec_sse2_(utn, MT_UTNLEN - MT_MAGICN, MT_UTNLEN - 1,
+                        MT_MAGICN - MT_UTNLEN);
+    mt_genrange_(utn, i, MT_UTNLEN - 1, MT_MAGICN - MT_UTNLEN);
+    mt_genlast_(utn);
+    
+    mt->idx = 0;
+}
+
+__attribute__((target("sse2")))
+inline static __m128i
+mt_sse2temper_(__m128i y)
+{
+    y = _mm_xor_si128(y, _mm_srli_epi32(y, MT_SHIFTA));
+    y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi32(y, MT_SHIFTB),
+                                       mt_sse2set1_(MT_MAGICMASKA)));
+    y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi32(y, MT_SHIFTC),
+                                       mt_sse2set1_(MT_MAGICMASKB)));
+    return _mm_xor_si128(y, _mm_srli_epi32(y, MT_SHIFTD));
+}
+
+__attribute__((target("sse2")))
+static void
+mt_temper_sse2_(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    size_t i;
+    __m128i y;
+    
+    for (i = 0; i + MT_SSE2LANES <= n; i += MT_SSE2LANES) {
+        y = mt_sse2temper_(_mm_loadu_si128((const __m128i *)&src[i]));
+        _mm_storeu_si128((__m128i *)&dst[i], y);
+    }
+    mt_temper_scalar_(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int
+mt_genvec_avx2_(uint32_t *utn, int from, int to, int off)
+{
+    const __m256i upper = mt_avx2set1_(MT_BIT31);
+    const __m256i lower = mt_avx2set1_(MT_BITS0TO30);
+    const __m256i one = mt_avx2set1_(1);
+    const __m256i matrix = mt_avx2set1_(MT_MATRIX);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i a, b, c, y;
+    int i;
+    
+    for (i = from; i + MT_AVX2LANES <= to; i += MT_AVX2LANES) {
+        a = _mm256_loadu_si256((const __m256i *)&utn[i]);
+        b = _mm256_loadu_si256((const __m256i *)&utn[i + 1]);
+        c = _mm256_loadu_si256((const __m256i *)&utn[i + off]);
+        y = _mm256_or_si256(_mm256_and_si256(a, upper),
+                            _mm256_and_si256(b, lower));
+        c = _mm256_xor_si256(c, _mm256_srli_epi32(y, 1));
+        y = _mm256_and_si256(_mm256_sub_epi32(zero, _mm256_and_si256(y, one)),
+                             matrix);
+        _mm256_storeu_si256((__m256i *)&utn[i], _mm256_xor_si256(c, y));
     }
-    y = mt_combinebits_(utn[i], utn[0]);
-    utn[i] = mt_matrixmultiply_(utn[MT_MAGICN - 1], y);
-            
+    return i;
+}
+
+__attribute__((target("avx2")))
+static void
+mt_gen_avx2_(struct mt *mt)
+{
+    uint32_t *utn = mt->utn;
+    int i;
+    
+    i = mt_genvec_avx2_(utn, 0, MT_UTNLEN - MT_MAGICN, MT_MAGICN);
+    mt_genrange_(utn, i, MT_UTNLEN - MT_MAGICN, MT_MAGICN);
+    i = mt_genvec_avx2_(utn, MT_UTNLEN - MT_MAGICN, MT_UTNLEN - 1,
+                        MT_MAGICN - MT_UTNLEN);
+    mt_genrange_(utn, i, MT_UTNLEN - 1, MT_MAGICN - MT_UTNLEN);
+    mt_genlast_(utn);
+    
     mt->idx = 0;
 }
 
-inline static unsigned long
+__attribute__((target("avx2")))
+inline static __m256i
+mt_avx2temper_(__m256i y)
+{
+    y = _mm256_xor_si256(y, _mm256_srli_epi32(y, MT_SHIFTA));
+    y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi32(y, MT_SHIFTB),
+                                             mt_avx2set1_(MT_MAGICMASKA)));
+    y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi32(y, MT_SHIFTC),
+                                             mt_avx2set1_(MT_MAGICMASKB)));
+    return _mm256_xor_si256(y, _mm256_srli_epi32(y, MT_SHIFTD));
+}
+
+__attribute__((target("avx2")))
+static void
+mt_temper_avx2_(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    size_t i;
+    __m256i y;
+    
+    for (i = 0; i + MT_AVX2LANES <= n; i += MT_AVX2LANES) {
+        y = mt_avx2temper_(_mm256_loadu_si256((const __m256i *)&src[i]));
+        _mm256_storeu_si256((__m256i *)&dst[i], y);
+    }
+    mt_temper_scalar_(dst + i, src + i, n - i);
+}
+
+#endif  /* MT_HAVE_X86SIMD */
+
+/* Selected once by mt_selectimpl_() when the first MT object is created
+ * (from any thread). All implementations produce identical results.
+ */
+static void (*mt_genfn_)(struct mt *mt) = mt_gen_scalar_;
+static void (*mt_temperfn_)(uint32_t *dst, const uint32_t *src,
+                            size_t n) = mt_temper_scalar_;
+
+static void
+mt_selectonce_(void)
+{
+#ifdef MT_HAVE_X86SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        mt_genfn_ = mt_gen_avx2_;
+        mt_temperfn_ = mt_temper_avx2_;
+    } else if (__builtin_cpu_supports("sse2")) {
+        mt_genfn_ = mt_gen_sse2_;
+        mt_temperfn_ = mt_temper_sse2_;
+    }
+#endif
+}
+
+static void
+mt_selectimpl_(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, mt_selectonce_);
+}
+
+inline static void 
+mt_gen_(struct mt *mt)
+{
+    mt_genfn_(mt);
+}
+
+/* Regenerate the single word at idx - MT_UTNLEN and return it
+ * (RAND_MT_MODE_SMOOTH)
+ */
+inline static uint32_t
+mt_genone_(struct mt *mt)
+{
+    uint32_t *utn = mt->utn, y;
+    int p = mt->idx - MT_UTNLEN, p1, pm;
+    
+    p1 = p + 1 < MT_UTNLEN ? p + 1 : 0;
+    pm = p + MT_MAGICN < MT_UTNLEN ? p + MT_MAGICN : p + MT_MAGICN - MT_UTNLEN;
+    
+    y = mt_combinebits_(utn[p], utn[p1]);
+    utn[p] = mt_matrixmultiply_(utn[pm], y);
+    mt->idx = p1 + MT_UTNLEN;
+    
+    return utn[p];
+}
+
+/* Undo the rotation of utn[] left by RAND_MT_MODE_SMOOTH so that utn[0] is
+ * the oldest word again, as mt_gen_() and mt_jump_() expect
+ */
+static void
+mt_linearise_(struct mt *mt)
+{
+    uint32_t tmp[MT_UTNLEN];
+    int p = mt->idx - MT_UTNLEN;
+    
+    if (p <= 0)
+        return;
+    memcpy(tmp, mt->utn, p * sizeof tmp[0]);
+    memmove(mt->utn, mt->utn + p, (MT_UTNLEN - p) * sizeof tmp[0]);
+    memcpy(mt->utn + MT_UTNLEN - p, tmp, p * sizeof tmp[0]);
+    mt->idx = MT_UTNLEN;
+}
+
+inline static uint32_t
 mt_rand_(struct mt *mt)
 {    
-    unsigned long y;
-    
-    if (mt->idx >= MT_UTNLEN)
+    if (mt->idx >= MT_UTNLEN) {
+        if (mt->mode == RAND_MT_MODE_SMOOTH)
+            return mt_temper_(mt_genone_(mt));
         mt_gen_(mt);
+    }
     
-    y = mt->utn[mt->idx++];
-    y ^= (y >> MT_SHIFTA);
-    y ^= (y << MT_SHIFTB) & MT_MAGICMASKA;
-    y ^= (y << MT_SHIFTC) & MT_MAGICMASKB;
-    y ^= (y >> MT_SHIFTD);
+    return mt_temper_(mt->utn[mt->idx++]);
+}
+
+inline static void
+mt_fill_(struct mt *mt, uint32_t *buf, size_t n)
+{
+    size_t k;
     
-    return y;
+    mt_linearise_(mt);
+    while (n > 0) {
+        if (mt->idx >= MT_UTNLEN)
+            mt_gen_(mt);
+        
+        k = MT_UTNLEN - mt->idx;
+        if (k > n)
+            k = n;
+        mt_temperfn_(buf, mt->utn + mt->idx, k);
+        mt->idx += k;
+        buf += k;
+        n -= k;
+    }
+}
+
+
+/**********************************************************************
+ * Jump ahead
+ * 
+ * The state transition T is linear over GF(2), so advancing the generator
+ * by J steps is the same as applying g(T) to the state where
+ * g(x) = x^J mod phi(x) and phi(x) is the characteristic polynomial of T.
+ * phi(x) (degree 19937) is recovered once using Berlekamp-Massey on
+ * 2 * 19937 output bits. g(T) is then applied with Horner's rule on a
+ * word-at-a-time (circular) copy of the state.
+ * 
+ * Reference: Haramoto, Matsumoto, Nishimura, Panneton, L'Ecuyer, "Efficient
+ * Jump Ahead for F2-Linear Random Number Generators", INFORMS Journal on
+ * Computing 20(3), 2008.
+ **********************************************************************/
+
+/* Note: phi(x) only depends on the MT parameters. It is computed by the
+ *       first call to mtrand_jump() or mtrand_split(), under mt_philock_ so
+ *       that concurrent first calls wait for it (and a failed attempt is
+ *       retried by the next call)
+ */
+static uint64_t mt_phi_[MT_PWORDS];
+static int mt_phiready_;
+static pthread_mutex_t mt_philock_ = PTHREAD_MUTEX_INITIALIZER;
+
+/* Word-at-a-time state: w[p] is the oldest word and the next word
+ * generated replaces it
+ */
+struct mt_jstate {
+    uint32_t        w[MT_UTNLEN];
+    int             p;
+};
+
+inline static int
+mt_parity64_(uint64_t x)
+{
+#ifdef __GNUC__
+    return __builtin_parityll(x);
+#else
+    x ^= x >> 32;
+    x ^= x >> 16;
+    x ^= x >> 8;
+    x ^= x >> 4;
+    x ^= x >> 2;
+    x ^= x >> 1;
+    return x & 1;
+#endif
+}
+
+/* Spread the low 32 bits of x over the even bits of the result (i.e.
+ * squaring over GF(2))
+ */
+inline static uint64_t
+mt_spread32_(uint64_t x)
+{
+    x &= 0xFFFFFFFFULL;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8))  & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2))  & 0x3333333333333333ULL;
+    x = (x | (x << 1))  & 0x5555555555555555ULL;
+    return x;
+}
+
+/* 64 bits of the bit array 'a' starting at bit 'b' */
+inline static uint64_t
+mt_bits64_(const uint64_t *a, unsigned long b)
+{
+    unsigned sh = b & 63;
+    
+    a += b >> 6;
+    return sh ? (a[0] >> sh) | (a[1] << (64 - sh)) : a[0];
+}
+
+/* dst ^= src * x^m where src has 'nw' significant words */
+static void
+mt_polyxorshift_(uint64_t *dst, const uint64_t *src, long nw, long m)
+{
+    long w;
+    unsigned sh = m & 63;
+    
+    dst += m >> 6;
+    for (w = 0; w < nw; w++) {
+        dst[w] ^= src[w] << sh;
+        if (sh)
+            dst[w + 1] ^= src[w] >> (64 - sh);
+    }
+}
+
+/* Compute phi(x) with Berlekamp-Massey. Returns 0 on success */
+static int
+mt_charpoly_(uint64_t *phi)
+{
+    const long nbits = 2L * MT_MEXP, nw = 2 * MT_PWORDS + 2;
+    struct mt gen;
+    uint64_t *r, *c, *b, *t, *tmp, acc;
+    long n, w, l, lb, m;
+    
+    r = calloc(4 * nw, sizeof *r);
+    if (r == NULL)
+        return -1;
+    c = r + nw;
+    b = c + nw;
+    t = b + nw;
+    
+    /* The low bit of each output, stored in reverse so that the bits
+     * s[n], s[n-1], ... s[n-L] are contiguous starting at nbits - 1 - n
+     */
+    mt_init_(&gen, 5489UL);
+    for (n = 0; n < nbits; n++)
+        if (mt_rand_(&gen) & 1)
+            r[(nbits - 1 - n) >> 6] |= 1ULL << ((nbits - 1 - n) & 63);
+    
+    c[0] = b[0] = 1;
+    l = lb = 0;
+    m = 1;
+    for (n = 0; n < nbits; n++) {
+        acc = 0;
+        for (w = 0; w <= l >> 6; w++)
+            acc ^= c[w] & mt_bits64_(r, nbits - 1 - n + 64 * w);
+        if (!mt_parity64_(acc)) {
+            m++;
+        } else if (2 * l <= n) {
+            memcpy(t, c, nw * sizeof *t);
+            mt_polyxorshift_(c, b, (lb >> 6) + 1, m);
+            lb = l;
+            l = n + 1 - l;
+            tmp = b; b = t; t = tmp;
+            m = 1;
+        } else {
+            mt_polyxorshift_(c, b, (lb >> 6) + 1, m);
+            m++;
+        }
+    }
+    
+    /* c is the connection polynomial; phi(x) = x^L c(1/x) */
+    if (l == MT_MEXP) {
+        memset(phi, 0, MT_PWORDS * sizeof *phi);
+        for (n = 0; n <= l; n++)
+            if ((c[n >> 6] >> (n & 63)) & 1)
+                phi[(l - n) >> 6] |= 1ULL << ((l - n) & 63);
+    }
+    
+    free(r);
+    return l == MT_MEXP ? 0 : -1;
+}
+
+/* Returns x^(2^log2n) mod phi(x) in a newly allocated array of MT_PWORDS
+ * words, or NULL on failure
+ */
+static uint64_t *
+mt_jumppoly_(unsigned log2n)
+{
+    uint64_t *g, *prod, *shphi;
+    unsigned k;
+    long i, t, w;
+    int ready;
+    
+    pthread_mutex_lock(&mt_philock_);
+    if (!mt_phiready_ && mt_charpoly_(mt_phi_) == 0)
+        mt_phiready_ = 1;
+    ready = mt_phiready_;
+    pthread_mutex_unlock(&mt_philock_);
+    if (!ready)
+        return NULL;
+    
+    g = calloc(MT_PWORDS + 2 * MT_PWORDS + 64 * (MT_PWORDS + 1), sizeof *g);
+    if (g == NULL)
+        return NULL;
+    prod = g + MT_PWORDS;
+    shphi = prod + 2 * MT_PWORDS;
+    
+    /* shphi[s] is phi(x) * x^s so that every reduction step is a word
+     * aligned xor
+     */
+    for (i = 0; i < 64; i++)
+        mt_polyxorshift_(shphi + i * (MT_PWORDS + 1), mt_phi_, MT_PWORDS, i);
+    
+    g[0] = 0x02;    /* x */
+    for (k = 0; k < log2n; k++) {
+        for (w = 0; w < MT_PWORDS; w++) {
+            prod[2 * w]     = mt_spread32_(g[w]);
+            prod[2 * w + 1] = mt_spread32_(g[w] >> 32);
+        }
+        for (i = 2L * (MT_MEXP - 1); i >= MT_MEXP; i--) {
+            if (!((prod[i >> 6] >> (i & 63)) & 1))
+                continue;
+            t = i - MT_MEXP;
+            for (w = 0; w < MT_PWORDS + 1; w++)
+                prod[(t >> 6) + w] ^= shphi[(t & 63) * (MT_PWORDS + 1) + w];
+        }
+        memcpy(g, prod, MT_PWORDS * sizeof *g);
+    }
+    
+    return g;
+}
+
+inline static void
+mt_jstep_(struct mt_jstate *s)
+{
+    int p = s->p, p1, pm;
+    
+    p1 = p + 1 < MT_UTNLEN ? p + 1 : 0;
+    pm = p + MT_MAGICN < MT_UTNLEN ? p + MT_MAGICN : p + MT_MAGICN - MT_UTNLEN;
+    s->w[p] = mt_matrixmultiply_(s->w[pm], mt_combinebits_(s->w[p], s->w[p1]));
+    s->p = p1;
+}
+
+/* d += s, word by word starting from the oldest word of each */
+static void
+mt_jadd_(struct mt_jstate *d, const struct mt_jstate *s)
+{
+    int i, j = s->p;
+    
+    for (i = d->p; i < MT_UTNLEN; i++) {
+        d->w[i] ^= s->w[j];
+        j = j + 1 < MT_UTNLEN ? j + 1 : 0;
+    }
+    for (i = 0; i < d->p; i++) {
+        d->w[i] ^= s->w[j];
+        j = j + 1 < MT_UTNLEN ? j + 1 : 0;
+    }
+}
+
+/* Apply g(T) to mt. utn[] always holds MT_UTNLEN consecutive words of the
+ * sequence with the oldest in utn[0], and mt->idx says how many of them have
+ * been output. Replacing the words with those J further on while keeping
+ * idx therefore advances the output by exactly J.
+ */
+static void
+mt_jump_(struct mt *mt, const uint64_t *g)
+{
+    struct mt_jstate acc, src;
+    long i, deg;
+    
+    for (deg = MT_MEXP - 1; deg > 0; deg--)
+        if ((g[deg >> 6] >> (deg & 63)) & 1)
+            break;
+    
+    mt_linearise_(mt);
+    memcpy(src.w, mt->utn, sizeof src.w);
+    src.p = 0;
+    memset(&acc, 0, sizeof acc);
+    
+    for (i = deg; i >= 0; i--) {
+        mt_jstep_(&acc);
+        if ((g[i >> 6] >> (i & 63)) & 1)
+            mt_jadd_(&acc, &src);
+    }
+    
+    for (i = 0; i < MT_UTNLEN; i++)
+        mt->utn[i] = acc.w[(acc.p + i) % MT_UTNLEN];
 }
 
 
@@ -152,11 +727,23 @@ RAND_MT *
 mtrand_new(unsigned long seed)
 {
     RAND_MT *mt;
+    
+    mt_selectimpl_();
     if ((mt = malloc(sizeof *mt)) != NULL)
         mt_init_(mt, seed);
     return mt;
 }
 
+RAND_MT *
+mtrand_init_inplace(void *mem, unsigned long seed)
+{
+    RAND_MT *mt = mem;
+    
+    mt_selectimpl_();
+    mt_init_(mt, seed);
+    return mt;
+}
+
 void 
 mtrand_dispose(RAND_MT *mt)
 {
@@ -168,3 +755,58 @@ mtrand_get(RAND_MT *mt)
 {
     return mt_rand_(mt);
 }
+
+void
+mtrand_fill(RAND_MT *mt, uint32_t *buf, size_t n)
+{
+    mt_fill_(mt, buf, n);
+}
+
+int
+mtrand_setmode(RAND_MT *mt, int mode)
+{
+    if (mode != RAND_MT_MODE_BLOCK && mode != RAND_MT_MODE_SMOOTH)
+        return -1;
+    mt_linearise_(mt);
+    mt->mode = mode;
+    return 0;
+}
+
+int
+mtrand_jump(RAND_MT *mt, unsigned log2n)
+{
+    uint64_t *g;
+    
+    if ((g = mt_jumppoly_(log2n)) == NULL)
+        return -1;
+    mt_jump_(mt, g);
+    free(g);
+    return 0;
+}
+
+int
+mtrand_split(RAND_MT *mt, RAND_MT **streams, int n, unsigned log2n)
+{
+    uint64_t *g;
+    int i;
+    
+    if ((g = mt_jumppoly_(log2n)) == NULL)
+        return -1;
+    
+    for (i = 0; i < n; i++) {
+        if ((streams[i] = malloc(sizeof *streams[i])) == NULL) {
+            while (i-- > 0)
+                free(streams[i]);
+            free(g);
+            return -1;
+        }
+    }
+    
+    for (i = 0; i < n; i++) {
+        *streams[i] = *mt;
+        mt_jump_(mt, g);
+    }
+    
+    free(g);
+    return 0;
+}
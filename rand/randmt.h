@@ -11,18 +11,69 @@
 #ifndef Z_RAND_MT
 #define Z_RAND_MT
 
+#include <stddef.h>
+#include <stdint.h>
+
 #define RAND_MT_MAX 0xffffffff
 
+/* Regeneration modes for mtrand_setmode() */
+#define RAND_MT_MODE_BLOCK      0   /* All 624 words every 624th call */
+#define RAND_MT_MODE_SMOOTH     1   /* One word every call */
+
+/* Size and alignment (in bytes) of a RAND_MT object; for use with
+ * mtrand_init_inplace()
+ */
+#define RAND_MT_SIZE    (624 * 4 + 8)
+#define RAND_MT_ALIGN   4
+
 /* "Handle" for Mersenne Twister object */
 typedef struct mt RAND_MT;
 
 /* Create a new RAND_MT object and initalise it using seed. */
 RAND_MT *mtrand_new(unsigned long seed);
 
+/* Initialise a RAND_MT object in caller-provided memory 'mem' which must be
+ * at least RAND_MT_SIZE bytes, aligned to RAND_MT_ALIGN. Objects may be
+ * packed contiguously in an array of RAND_MT_SIZE byte elements. Returns
+ * 'mem' as a RAND_MT handle, which must not be passed to mtrand_dispose().
+ */
+RAND_MT *mtrand_init_inplace(void *mem, unsigned long seed);
+
 /* Free resources allocated for RAND_MT created with mtrand_new() */
 void mtrand_dispose(RAND_MT *mt);
 
 /* Get random number. */
 unsigned long mtrand_get(RAND_MT *mt);
 
+/* Write the next 'n' random numbers to 'buf'. The sequence is the same as
+ * that of 'n' calls to mtrand_get() and the two may be freely mixed.
+ */
+void mtrand_fill(RAND_MT *mt, uint32_t *buf, size_t n);
+
+/* Select how the state is regenerated. RAND_MT_MODE_BLOCK (the default) has
+ * the best throughput but every 624th call to mtrand_get() regenerates the
+ * whole state. RAND_MT_MODE_SMOOTH regenerates one word per call, so every
+ * call costs about the same. The sequence is the same in both modes and the
+ * mode can be changed at any time. Returns 0, or -1 (leaving mt unchanged)
+ * if 'mode' is neither of the two.
+ */
+int mtrand_setmode(RAND_MT *mt, int mode);
+
+/* Advance mt by 2^log2n numbers; i.e. as if mtrand_get() had been called
+ * 2^log2n times. Returns 0 on success or -1 if memory could not be allocated.
+ * The first call to mtrand_jump() or mtrand_split() computes a table that is
+ * shared by all RAND_MT objects; other threads calling either function in
+ * the meantime wait for it.
+ */
+int mtrand_jump(RAND_MT *mt, unsigned log2n);
+
+/* Create 'n' new RAND_MT objects, one per parallel stream. streams[0] starts
+ * where mt currently is and each following stream starts 2^log2n numbers
+ * after the previous one; mt itself is advanced past all of them. Streams
+ * therefore do not overlap unless more than 2^log2n numbers are taken from
+ * one of them (e.g. log2n = 64). Each stream must be freed with
+ * mtrand_dispose(). Returns 0 on success or -1 (and mt unchanged) on failure.
+ */
+int mtrand_split(RAND_MT *mt, RAND_MT **streams, int n, unsigned log2n);
+
 #endif /* Z_RAND_MT */
@@ -0,0 +1,292 @@
+/*
+ * Mersenne Twister MT19937-64 (64-bit)
+ * 
+ * License: BSD-3
+ */
+
+/* 
+ * References: 
+ * http://www.math.sci.hiroshima-u.ac.jp/~m-mat/MT/emt64.html
+ * ref/mt19937-64.c
+ */
+
+#include "randmt64.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+/* As in randmt.c: an AVX2 path is selected at runtime on x86 with
+ * gcc/clang. Define MT_NO_SIMD to force the portable scalar path.
+ */
+#if !defined(MT_NO_SIMD) && defined(__GNUC__) \
+        && (defined(__x86_64__) || defined(__i386__))
+#   define MT64_HAVE_X86SIMD
+#   include <immintrin.h>
+#endif
+
+/**********************************************************************
+ * Private
+ **********************************************************************/
+
+#define KNUTH_MULTIPLIER64  6364136223846793005ULL
+#define KNUTH_SHIFT64       62
+
+#define MT64_UTNLEN         312
+#define MT64_MAGICN         156
+#define MT64_MATRIX         0xB5026F5AA96619E9ULL
+
+#define MT64_SHIFTA         29
+#define MT64_SHIFTB         17
+#define MT64_SHIFTC         37
+#define MT64_SHIFTD         43
+
+#define MT64_MAGICMASKA     0x5555555555555555ULL
+#define MT64_MAGICMASKB     0x71D67FFFEDA60000ULL
+#define MT64_MAGICMASKC     0xFFF7EEE000000000ULL
+
+#define MT64_UPPER33        0xFFFFFFFF80000000ULL
+#define MT64_LOWER31        0x7FFFFFFFULL
+
+#define MT64_2POWM53        (1.0 / 9007199254740992.0)
+
+struct mt64 {
+    uint64_t        utn[MT64_UTNLEN];
+    int             idx;
+};
+
+inline static void 
+mt64_init_(struct mt64 *mt, uint64_t seed)
+{
+    int i;
+    uint64_t *utn = mt->utn;
+    
+    utn[0] = seed;
+    for (i = 1; i < MT64_UTNLEN; i++)
+        utn[i] = KNUTH_MULTIPLIER64 * (utn[i-1] ^ (utn[i-1] >> KNUTH_SHIFT64))
+                 + i;
+    
+    /* First call to mt64_rand_() triggers a call to mt64_gen_() */
+    mt->idx = i;
+}
+
+inline static uint64_t
+mt64_twist_(uint64_t a, uint64_t b, uint64_t c)
+{
+    uint64_t y = (b & MT64_UPPER33) | (c & MT64_LOWER31);
+    
+    return a ^ (y >> 1) ^ (-(y & 0x01) & MT64_MATRIX);
+}
+
+/* Regenerate utn[i] for i in [from, to); see mt_genrange_() in randmt.c */
+inline static void
+mt64_genrange_(uint64_t *utn, int from, int to, int off)
+{
+    int i;
+    
+    for (i = from; i < to; i++)
+        utn[i] = mt64_twist_(utn[i + off], utn[i], utn[i + 1]);
+}
+
+static void 
+mt64_gen_scalar_(struct mt64 *mt)
+{
+    uint64_t *utn = mt->utn;
+    
+    mt64_genrange_(utn, 0, MT64_UTNLEN - MT64_MAGICN, MT64_MAGICN);
+    mt64_genrange_(utn, MT64_UTNLEN - MT64_MAGICN, MT64_UTNLEN - 1,
+                   MT64_MAGICN - MT64_UTNLEN);
+    utn[MT64_UTNLEN - 1] = mt64_twist_(utn[MT64_MAGICN - 1],
+                                       utn[MT64_UTNLEN - 1], utn[0]);
+    
+    mt->idx = 0;
+}
+
+inline static uint64_t
+mt64_temper_(uint64_t y)
+{
+    y ^= (y >> MT64_SHIFTA) & MT64_MAGICMASKA;
+    y ^= (y << MT64_SHIFTB) & MT64_MAGICMASKB;
+    y ^= (y << MT64_SHIFTC) & MT64_MAGICMASKC;
+    y ^= (y >> MT64_SHIFTD);
+    
+    return y;
+}
+
+static void
+mt64_temper_scalar_(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    size_t i;
+    
+    for (i = 0; i < n; i++)
+        dst[i] = mt64_temper_(src[i]);
+}
+
+#ifdef MT64_HAVE_X86SIMD
+
+/* Same scheme as the vector paths in randmt.c, with four 64-bit words per
+ * step. Runs of up to MT64_UTNLEN - MT64_MAGICN = 156 words are
+ * independent.
+ */
+#define MT64_AVX2LANES          4
+#define mt64_avx2set1_(x)       _mm256_set1_epi64x((long long)(x))
+
+__attribute__((target("avx2")))
+static int
+mt64_genvec_avx2_(uint64_t *utn, int from, int to, int off)
+{
+    const __m256i upper = mt64_avx2set1_(MT64_UPPER33);
+    const __m256i lower = mt64_avx2set1_(MT64_LOWER31);
+    const __m256i one = mt64_avx2set1_(1);
+    const __m256i matrix = mt64_avx2set1_(MT64_MATRIX);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i a, b, c, y;
+    int i;
+    
+    for (i = from; i + MT64_AVX2LANES <= to; i += MT64_AVX2LANES) {
+        a = _mm256_loadu_si256((const __m256i *)&utn[i]);
+        b = _mm256_loadu_si256((const __m256i *)&utn[i + 1]);
+        c = _mm256_loadu_si256((const __m256i *)&utn[i + off]);
+        y = _mm256_or_si256(_mm256_and_si256(a, upper),
+                            _mm256_and_si256(b, lower));
+        c = _mm256_xor_si256(c, _mm256_srli_epi64(y, 1));
+        y = _mm256_and_si256(_mm256_sub_epi64(zero, _mm256_and_si256(y, one)),
+                             matrix);
+        _mm256_storeu_si256((__m256i *)&utn[i], _mm256_xor_si256(c, y));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static void
+mt64_gen_avx2_(struct mt64 *mt)
+{
+    uint64_t *utn = mt->utn;
+    int i;
+    
+    i = mt64_genvec_avx2_(utn, 0, MT64_UTNLEN - MT64_MAGICN, MT64_MAGICN);
+    mt64_genrange_(utn, i, MT64_UTNLEN - MT64_MAGICN, MT64_MAGICN);
+    i = mt64_genvec_avx2_(utn, MT64_UTNLEN - MT64_MAGICN, MT64_UTNLEN - 1,
+                          MT64_MAGICN - MT64_UTNLEN);
+    mt64_genrange_(utn, i, MT64_UTNLEN - 1, MT64_MAGICN - MT64_UTNLEN);
+    utn[MT64_UTNLEN - 1] = mt64_twist_(utn[MT64_MAGICN - 1],
+                                       utn[MT64_UTNLEN - 1], utn[0]);
+    
+    mt->idx = 0;
+}
+
+__attribute__((target("avx2")))
+static void
+mt64_temper_avx2_(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    const __m256i ma = mt64_avx2set1_(MT64_MAGICMASKA);
+    const __m256i mb = mt64_avx2set1_(MT64_MAGICMASKB);
+    const __m256i mc = mt64_avx2set1_(MT64_MAGICMASKC);
+    size_t i;
+    __m256i y;
+    
+    for (i = 0; i + MT64_AVX2LANES <= n; i += MT64_AVX2LANES) {
+        y = _mm256_loadu_si256((const __m256i *)&src[i]);
+        y = _mm256_xor_si256(y, _mm256_and_si256(
+                _mm256_srli_epi64(y, MT64_SHIFTA), ma));
+        y = _mm256_xor_si256(y, _mm256_and_si256(
+                _mm256_slli_epi64(y, MT64_SHIFTB), mb));
+        y = _mm256_xor_si256(y, _mm256_and_si256(
+                _mm256_slli_epi64(y, MT64_SHIFTC), mc));
+        y = _mm256_xor_si256(y, _mm256_srli_epi64(y, MT64_SHIFTD));
+        _mm256_storeu_si256((__m256i *)&dst[i], y);
+    }
+    mt64_temper_scalar_(dst + i, src + i, n - i);
+}
+
+#endif  /* MT64_HAVE_X86SIMD */
+
+static void (*mt64_genfn_)(struct mt64 *mt) = mt64_gen_scalar_;
+static void (*mt64_temperfn_)(uint64_t *dst, const uint64_t *src,
+                              size_t n) = mt64_temper_scalar_;
+
+static void
+mt64_selectonce_(void)
+{
+#ifdef MT64_HAVE_X86SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        mt64_genfn_ = mt64_gen_avx2_;
+        mt64_temperfn_ = mt64_temper_avx2_;
+    }
+#endif
+}
+
+static void
+mt64_selectimpl_(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, mt64_selectonce_);
+}
+
+inline static void
+mt64_gen_(struct mt64 *mt)
+{
+    mt64_genfn_(mt);
+}
+
+inline static uint64_t
+mt64_rand_(struct mt64 *mt)
+{
+    if (mt->idx >= MT64_UTNLEN)
+        mt64_gen_(mt);
+    
+    return mt64_temper_(mt->utn[mt->idx++]);
+}
+
+
+/**********************************************************************
+ * Public
+ **********************************************************************/
+
+RAND_MT64 *
+mtrand64_new(uint64_t seed)
+{
+    RAND_MT64 *mt;
+    
+    mt64_selectimpl_();
+    if ((mt = malloc(sizeof *mt)) != NULL)
+        mt64_init_(mt, seed);
+    return mt;
+}
+
+void 
+mtrand64_dispose(RAND_MT64 *mt)
+{
+    free(mt);
+}
+
+uint64_t
+mtrand64_get(RAND_MT64 *mt)
+{
+    return mt64_rand_(mt);
+}
+
+void
+mtrand64_fill(RAND_MT64 *mt, uint64_t *buf, size_t n)
+{
+    size_t k;
+    
+    while (n > 0) {
+        if (mt->idx >= MT64_UTNLEN)
+            mt64_gen_(mt);
+        
+        k = MT64_UTNLEN - mt->idx;
+        if (k > n)
+            k = n;
+        mt64_temperfn_(buf, mt->utn + mt->idx, k);
+        mt->idx += k;
+        buf += k;
+        n -= k;
+    }
+}
+
+double
+mtrand64_double(RAND_MT64 *mt)
+{
+    return (mt64_rand_(mt) >> 11) * MT64_2POWM53;
+}
@@ -0,0 +1,37 @@
+/*
+ * Mersenne Twister MT19937-64 (64-bit)
+ * 
+ * License: BSD-3
+ */
+
+#ifndef Z_RAND_MT64
+#define Z_RAND_MT64
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RAND_MT64_MAX 0xffffffffffffffffULL
+
+/* "Handle" for 64-bit Mersenne Twister object */
+typedef struct mt64 RAND_MT64;
+
+/* Create a new RAND_MT64 object and initalise it using seed. */
+RAND_MT64 *mtrand64_new(uint64_t seed);
+
+/* Free resources allocated for RAND_MT64 created with mtrand64_new() */
+void mtrand64_dispose(RAND_MT64 *mt);
+
+/* Get random number. */
+uint64_t mtrand64_get(RAND_MT64 *mt);
+
+/* Write the next 'n' random numbers to 'buf'. The sequence is the same as
+ * that of 'n' calls to mtrand64_get() and the two may be freely mixed.
+ */
+void mtrand64_fill(RAND_MT64 *mt, uint64_t *buf, size_t n);
+
+/* Random double in [0, 1) with 53-bit resolution from a single number (the
+ * same as genrand64_real2() in the reference implementation)
+ */
+double mtrand64_double(RAND_MT64 *mt);
+
+#endif /* Z_RAND_MT64 */
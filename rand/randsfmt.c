@@ -0,0 +1,290 @@
+/*
+ * SIMD-oriented Fast Mersenne Twister SFMT19937 (32-bit output)
+ * 
+ * License: BSD-3
+ */
+
+/* 
+ * References: 
+ * M. Saito, M. Matsumoto, "SIMD-oriented Fast Mersenne Twister: a 128-bit
+ *     Pseudorandom Number Generator", Monte Carlo and Quasi-Monte Carlo
+ *     Methods 2006
+ * http://www.math.sci.hiroshima-u.ac.jp/~m-mat/MT/SFMT/index.html
+ * ref/sfmt19937.c
+ */
+
+#include "randsfmt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* As in randmt.c: the SSE2 recursion is selected at runtime on x86 with
+ * gcc/clang. Define SFMT_NO_SIMD to force the portable scalar path.
+ */
+#if !defined(SFMT_NO_SIMD) && defined(__GNUC__) \
+        && (defined(__x86_64__) || defined(__i386__))
+#   define SFMT_HAVE_X86SIMD
+#   include <immintrin.h>
+#endif
+
+/**********************************************************************
+ * Private
+ **********************************************************************/
+
+#define KNUTH_MULTIPLIER    1812433253UL
+#define KNUTH_SHIFT         30
+
+/* Parameters for MEXP = 19937. The state is SFMT_N 128-bit words, each
+ * stored as four 32-bit words with w[0] the least significant.
+ */
+#define SFMT_MEXP           19937
+#define SFMT_N              (SFMT_MEXP / 128 + 1)
+#define SFMT_N32            (SFMT_N * 4)
+#define SFMT_POS1           122
+#define SFMT_SL1            18
+#define SFMT_SL2            1       /* bytes */
+#define SFMT_SR1            11
+#define SFMT_SR2            1       /* bytes */
+#define SFMT_MSK1           0xdfffffefU
+#define SFMT_MSK2           0xddfecb7fU
+#define SFMT_MSK3           0xbffaffffU
+#define SFMT_MSK4           0xbffffff6U
+#define SFMT_PARITY1        0x00000001U
+#define SFMT_PARITY2        0x00000000U
+#define SFMT_PARITY3        0x00000000U
+#define SFMT_PARITY4        0x13c9e684U
+
+struct sfmt {
+    uint32_t        utn[SFMT_N32];
+    int             idx;
+};
+
+static void sfmt_selectimpl_(void);
+
+/* Ensure the period is 2^19937 - 1 by fixing up one bit if needed */
+static void
+sfmt_certify_(struct sfmt *s)
+{
+    static const uint32_t parity[4] = {
+        SFMT_PARITY1, SFMT_PARITY2, SFMT_PARITY3, SFMT_PARITY4
+    };
+    uint32_t inner = 0, work;
+    int i, j;
+    
+    for (i = 0; i < 4; i++)
+        inner ^= s->utn[i] & parity[i];
+    for (i = 16; i > 0; i >>= 1)
+        inner ^= inner >> i;
+    if (inner & 1)
+        return;
+    
+    for (i = 0; i < 4; i++)
+        for (j = 0, work = 1; j < 32; j++, work <<= 1)
+            if (work & parity[i]) {
+                s->utn[i] ^= work;
+                return;
+            }
+}
+
+inline static void
+sfmt_init_(struct sfmt *s, uint32_t seed)
+{
+    int i;
+    uint32_t *utn = s->utn;
+    
+    utn[0] = seed;
+    for (i = 1; i < SFMT_N32; i++)
+        utn[i] = KNUTH_MULTIPLIER * (utn[i-1] ^ (utn[i-1] >> KNUTH_SHIFT)) + i;
+    s->idx = i;
+    sfmt_certify_(s);
+}
+
+/* r = a ^ (a << SL2 bytes) ^ ((b >> SR1) & MSK) ^ (c >> SR2 bytes)
+ *       ^ (d << SL1)
+ * on 128-bit words (the byte shifts cross 32-bit word boundaries)
+ */
+inline static void
+sfmt_recursion_(uint32_t *r, const uint32_t *a, const uint32_t *b,
+                const uint32_t *c, const uint32_t *d)
+{
+    static const uint32_t msk[4] = {
+        SFMT_MSK1, SFMT_MSK2, SFMT_MSK3, SFMT_MSK4
+    };
+    uint64_t ah, al, ch, cl, xh, xl, yh, yl;
+    uint32_t x[4], y[4];
+    int i;
+    
+    ah = ((uint64_t)a[3] << 32) | a[2];
+    al = ((uint64_t)a[1] << 32) | a[0];
+    xh = (ah << (SFMT_SL2 * 8)) | (al >> (64 - SFMT_SL2 * 8));
+    xl = al << (SFMT_SL2 * 8);
+    
+    ch = ((uint64_t)c[3] << 32) | c[2];
+    cl = ((uint64_t)c[1] << 32) | c[0];
+    yh = ch >> (SFMT_SR2 * 8);
+    yl = (cl >> (SFMT_SR2 * 8)) | (ch << (64 - SFMT_SR2 * 8));
+    
+    x[0] = (uint32_t)xl; x[1] = (uint32_t)(xl >> 32);
+    x[2] = (uint32_t)xh; x[3] = (uint32_t)(xh >> 32);
+    y[0] = (uint32_t)yl; y[1] = (uint32_t)(yl >> 32);
+    y[2] = (uint32_t)yh; y[3] = (uint32_t)(yh >> 32);
+    
+    for (i = 0; i < 4; i++)
+        r[i] = a[i] ^ x[i] ^ ((b[i] >> SFMT_SR1) & msk[i]) ^ y[i]
+               ^ (d[i] << SFMT_SL1);
+}
+
+static void
+sfmt_gen_scalar_(struct sfmt *s)
+{
+    uint32_t *utn = s->utn;
+    const uint32_t *r1, *r2;
+    int i;
+    
+    r1 = &utn[4 * (SFMT_N - 2)];
+    r2 = &utn[4 * (SFMT_N - 1)];
+    for (i = 0; i < SFMT_N - SFMT_POS1; i++) {
+        sfmt_recursion_(&utn[4 * i], &utn[4 * i],
+                        &utn[4 * (i + SFMT_POS1)], r1, r2);
+        r1 = r2;
+        r2 = &utn[4 * i];
+    }
+    for (; i < SFMT_N; i++) {
+        sfmt_recursion_(&utn[4 * i], &utn[4 * i],
+                        &utn[4 * (i + SFMT_POS1 - SFMT_N)], r1, r2);
+        r1 = r2;
+        r2 = &utn[4 * i];
+    }
+    
+    s->idx = 0;
+}
+
+#ifdef SFMT_HAVE_X86SIMD
+
+/* The recursion was designed for this: one 128-bit word per step */
+__attribute__((target("sse2")))
+inline static __m128i
+sfmt_recursion_sse2_(__m128i a, __m128i b, __m128i c, __m128i d, __m128i msk)
+{
+    __m128i x, y, z, v;
+    
+    x = _mm_slli_si128(a, SFMT_SL2);
+    y = _mm_and_si128(_mm_srli_epi32(b, SFMT_SR1), msk);
+    z = _mm_srli_si128(c, SFMT_SR2);
+    v = _mm_slli_epi32(d, SFMT_SL1);
+    
+    return _mm_xor_si128(_mm_xor_si128(_mm_xor_si128(a, x), y),
+                         _mm_xor_si128(z, v));
+}
+
+__attribute__((target("sse2")))
+static void
+sfmt_gen_sse2_(struct sfmt *s)
+{
+    __m128i *st = (__m128i *)s->utn;
+    const __m128i msk = _mm_set_epi32((int)SFMT_MSK4, (int)SFMT_MSK3,
+                                      (int)SFMT_MSK2, (int)SFMT_MSK1);
+    __m128i r1, r2, r;
+    int i;
+    
+    r1 = _mm_loadu_si128(&st[SFMT_N - 2]);
+    r2 = _mm_loadu_si128(&st[SFMT_N - 1]);
+    for (i = 0; i < SFMT_N - SFMT_POS1; i++) {
+        r = sfmt_recursion_sse2_(_mm_loadu_si128(&st[i]),
+                                 _mm_loadu_si128(&st[i + SFMT_POS1]),
+                                 r1, r2, msk);
+        _mm_storeu_si128(&st[i], r);
+        r1 = r2;
+        r2 = r;
+    }
+    for (; i < SFMT_N; i++) {
+        r = sfmt_recursion_sse2_(_mm_loadu_si128(&st[i]),
+                                 _mm_loadu_si128(&st[i + SFMT_POS1 - SFMT_N]),
+                                 r1, r2, msk);
+        _mm_storeu_si128(&st[i], r);
+        r1 = r2;
+        r2 = r;
+    }
+    
+    s->idx = 0;
+}
+
+#endif  /* SFMT_HAVE_X86SIMD */
+
+static void (*sfmt_genfn_)(struct sfmt *s) = sfmt_gen_scalar_;
+
+static void
+sfmt_selectonce_(void)
+{
+#ifdef SFMT_HAVE_X86SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        sfmt_genfn_ = sfmt_gen_sse2_;
+#endif
+}
+
+/* Once, however many threads create generators */
+static void
+sfmt_selectimpl_(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, sfmt_selectonce_);
+}
+
+inline static uint32_t
+sfmt_rand_(struct sfmt *s)
+{
+    if (s->idx >= SFMT_N32)
+        sfmt_genfn_(s);
+    
+    return s->utn[s->idx++];
+}
+
+
+/**********************************************************************
+ * Public
+ **********************************************************************/
+
+RAND_SFMT *
+sfmtrand_new(uint32_t seed)
+{
+    RAND_SFMT *s;
+    
+    sfmt_selectimpl_();
+    if ((s = malloc(sizeof *s)) != NULL)
+        sfmt_init_(s, seed);
+    return s;
+}
+
+void 
+sfmtrand_dispose(RAND_SFMT *sfmt)
+{
+    free(sfmt);
+}
+
+uint32_t
+sfmtrand_get(RAND_SFMT *sfmt)
+{
+    return sfmt_rand_(sfmt);
+}
+
+/* There is no tempering so a fill is just a copy of the state */
+void
+sfmtrand_fill(RAND_SFMT *sfmt, uint32_t *buf, size_t n)
+{
+    size_t k;
+    
+    while (n > 0) {
+        if (sfmt->idx >= SFMT_N32)
+            sfmt_genfn_(sfmt);
+        
+        k = SFMT_N32 - sfmt->idx;
+        if (k > n)
+            k = n;
+        memcpy(buf, sfmt->utn + sfmt->idx, k * sizeof *buf);
+        sfmt->idx += k;
+        buf += k;
+        n -= k;
+    }
+}
@@ -0,0 +1,32 @@
+/*
+ * SIMD-oriented Fast Mersenne Twister SFMT19937 (32-bit output)
+ * 
+ * License: BSD-3
+ */
+
+#ifndef Z_RAND_SFMT
+#define Z_RAND_SFMT
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RAND_SFMT_MAX 0xffffffff
+
+/* "Handle" for SFMT object */
+typedef struct sfmt RAND_SFMT;
+
+/* Create a new RAND_SFMT object and initalise it using seed. */
+RAND_SFMT *sfmtrand_new(uint32_t seed);
+
+/* Free resources allocated for RAND_SFMT created with sfmtrand_new() */
+void sfmtrand_dispose(RAND_SFMT *sfmt);
+
+/* Get random number. */
+uint32_t sfmtrand_get(RAND_SFMT *sfmt);
+
+/* Write the next 'n' random numbers to 'buf'. The sequence is the same as
+ * that of 'n' calls to sfmtrand_get() and the two may be freely mixed.
+ */
+void sfmtrand_fill(RAND_SFMT *sfmt, uint32_t *buf, size_t n);
+
+#endif /* Z_RAND_SFMT */
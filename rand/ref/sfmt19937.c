@@ -0,0 +1,232 @@
+/*
+   SIMD-oriented Fast Mersenne Twister (SFMT), MEXP = 19937.
+   Plain C (non-SIMD) version of the generator, 32-bit output only.
+   Based on SFMT.c by Mutsuo Saito and Makoto Matsumoto.
+
+   Copyright (C) 2006, 2007 Mutsuo Saito, Makoto Matsumoto and Hiroshima
+   University.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are
+   met:
+
+     * Redistributions of source code must retain the above copyright
+       notice, this list of conditions and the following disclaimer.
+     * Redistributions in binary form must reproduce the above
+       copyright notice, this list of conditions and the following
+       disclaimer in the documentation and/or other materials provided
+       with the distribution.
+     * Neither the name of the Hiroshima University nor the names of
+       its contributors may be used to endorse or promote products
+       derived from this software without specific prior written
+       permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   http://www.math.sci.hiroshima-u.ac.jp/~m-mat/MT/SFMT/index.html
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Parameters for MEXP = 19937 (SFMT-params19937.h) */
+#define MEXP 19937
+#define N (MEXP / 128 + 1)
+#define N32 (N * 4)
+#define POS1 122
+#define SL1 18
+#define SL2 1
+#define SR1 11
+#define SR2 1
+#define MSK1 0xdfffffefU
+#define MSK2 0xddfecb7fU
+#define MSK3 0xbffaffffU
+#define MSK4 0xbffffff6U
+#define PARITY1 0x00000001U
+#define PARITY2 0x00000000U
+#define PARITY3 0x00000000U
+#define PARITY4 0x13c9e684U
+
+/* 128-bit data structure; u[0] is the least significant word */
+typedef struct {
+    uint32_t u[4];
+} w128_t;
+
+/* the 128-bit internal state array */
+static w128_t sfmt[N];
+/* the 32-bit integer pointer to the 128-bit internal state array */
+static uint32_t *psfmt32 = &sfmt[0].u[0];
+/* index counter to the 32-bit internal state array */
+static int idx;
+/* a parity check vector which certificate the period of 2^{MEXP} */
+static uint32_t parity[4] = {PARITY1, PARITY2, PARITY3, PARITY4};
+
+/* simulates SIMD 128-bit right shift by 'shift' bytes */
+static void rshift128(w128_t *out, w128_t const *in, int shift)
+{
+    uint64_t th, tl, oh, ol;
+
+    th = ((uint64_t)in->u[3] << 32) | ((uint64_t)in->u[2]);
+    tl = ((uint64_t)in->u[1] << 32) | ((uint64_t)in->u[0]);
+
+    oh = th >> (shift * 8);
+    ol = tl >> (shift * 8);
+    ol |= th << (64 - shift * 8);
+    out->u[1] = (uint32_t)(ol >> 32);
+    out->u[0] = (uint32_t)ol;
+    out->u[3] = (uint32_t)(oh >> 32);
+    out->u[2] = (uint32_t)oh;
+}
+
+/* simulates SIMD 128-bit left shift by 'shift' bytes */
+static void lshift128(w128_t *out, w128_t const *in, int shift)
+{
+    uint64_t th, tl, oh, ol;
+
+    th = ((uint64_t)in->u[3] << 32) | ((uint64_t)in->u[2]);
+    tl = ((uint64_t)in->u[1] << 32) | ((uint64_t)in->u[0]);
+
+    oh = th << (shift * 8);
+    ol = tl << (shift * 8);
+    oh |= tl >> (64 - shift * 8);
+    out->u[1] = (uint32_t)(ol >> 32);
+    out->u[0] = (uint32_t)ol;
+    out->u[3] = (uint32_t)(oh >> 32);
+    out->u[2] = (uint32_t)oh;
+}
+
+/* the recursion formula */
+static void do_recursion(w128_t *r, w128_t *a, w128_t *b, w128_t *c,
+                         w128_t *d)
+{
+    w128_t x;
+    w128_t y;
+
+    lshift128(&x, a, SL2);
+    rshift128(&y, c, SR2);
+    r->u[0] = a->u[0] ^ x.u[0] ^ ((b->u[0] >> SR1) & MSK1) ^ y.u[0]
+        ^ (d->u[0] << SL1);
+    r->u[1] = a->u[1] ^ x.u[1] ^ ((b->u[1] >> SR1) & MSK2) ^ y.u[1]
+        ^ (d->u[1] << SL1);
+    r->u[2] = a->u[2] ^ x.u[2] ^ ((b->u[2] >> SR1) & MSK3) ^ y.u[2]
+        ^ (d->u[2] << SL1);
+    r->u[3] = a->u[3] ^ x.u[3] ^ ((b->u[3] >> SR1) & MSK4) ^ y.u[3]
+        ^ (d->u[3] << SL1);
+}
+
+/* fills the internal state array with pseudorandom integers */
+static void gen_rand_all(void)
+{
+    int i;
+    w128_t *r1, *r2;
+
+    r1 = &sfmt[N - 2];
+    r2 = &sfmt[N - 1];
+    for (i = 0; i < N - POS1; i++) {
+        do_recursion(&sfmt[i], &sfmt[i], &sfmt[i + POS1], r1, r2);
+        r1 = r2;
+        r2 = &sfmt[i];
+    }
+    for (; i < N; i++) {
+        do_recursion(&sfmt[i], &sfmt[i], &sfmt[i + POS1 - N], r1, r2);
+        r1 = r2;
+        r2 = &sfmt[i];
+    }
+}
+
+/* certificate the period of 2^{MEXP} */
+static void period_certification(void)
+{
+    int inner = 0;
+    int i, j;
+    uint32_t work;
+
+    for (i = 0; i < 4; i++)
+        inner ^= psfmt32[i] & parity[i];
+    for (i = 16; i > 0; i >>= 1)
+        inner ^= inner >> i;
+    inner &= 1;
+    /* check OK */
+    if (inner == 1) {
+        return;
+    }
+    /* check NG, and modification */
+    for (i = 0; i < 4; i++) {
+        work = 1;
+        for (j = 0; j < 32; j++) {
+            if ((work & parity[i]) != 0) {
+                psfmt32[i] ^= work;
+                return;
+            }
+            work = work << 1;
+        }
+    }
+}
+
+/* generates and returns 32-bit pseudorandom integer */
+uint32_t gen_rand32(void)
+{
+    uint32_t r;
+
+    if (idx >= N32) {
+        gen_rand_all();
+        idx = 0;
+    }
+    r = psfmt32[idx++];
+    return r;
+}
+
+/* initializes the internal state array with a 32-bit integer seed */
+void init_gen_rand(uint32_t seed)
+{
+    int i;
+
+    psfmt32[0] = seed;
+    for (i = 1; i < N32; i++) {
+        psfmt32[i] = 1812433253UL * (psfmt32[i - 1]
+                                     ^ (psfmt32[i - 1] >> 30))
+            + i;
+    }
+    idx = N32;
+    period_certification();
+}
+
+int main(void)
+{
+#if 0
+    /* First outputs in SFMT.19937.out.txt:
+     * 3440181298 1564997079 1510669302 2930277156 1452439940 */
+    int i;
+    init_gen_rand(1234);
+    for (i = 0; i < 1000; i++) {
+        printf("%10u ", gen_rand32());
+        if (i % 5 == 4) printf("\n");
+    }
+#endif
+    /* Same output as mt19937ar.c (see out.txt), but for SFMT */
+    size_t i;
+    int count[2] = {0};
+
+    init_gen_rand(10);
+
+    for (i = 0; i < 2000; i++) {
+        uint32_t x = gen_rand32();
+        count[x % 2]++;
+        printf("%u\n", x);
+    }
+
+    printf("0s: %d  1s: %d\n", count[0], count[1]);
+
+    return 0;
+}
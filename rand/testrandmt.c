@@ -1,31 +1,134 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include <assert.h>
 #include "randmt.h"
 
 #define NUM 100000000
+#define SEED 10
 
-int main(void)
+/* Words per mtrand_fill()/fwrite() in --binary mode (1 MiB) */
+#define BINBUFLEN (1 << 18)
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--count N] [--seed S] [--binary] [--out FILE]\n"
+            "  --count N   numbers to generate (default %d; with --binary,\n"
+            "              0 streams until the output is closed)\n"
+            "  --seed S    seed (default %d)\n"
+            "  --binary    raw little-endian 32-bit words instead of text\n"
+            "  --out FILE  write to FILE instead of stdout\n",
+            prog, NUM, SEED);
+}
+
+/* Convert buf in place to little-endian byte order (no-op on little-endian
+ * hosts)
+ */
+static void tolittleendian(uint32_t *buf, size_t n)
 {
-    RAND_MT *mt;    
+    const union { uint32_t u; unsigned char c[4]; } probe = { 1 };
+    unsigned char *p;
+    uint32_t x;
     size_t i;
-    int count[2] = {0};
-    volatile unsigned long x;
-    
+
+    if (probe.c[0] == 1)
+        return;
+    for (i = 0; i < n; i++) {
+        x = buf[i];
+        p = (unsigned char *)&buf[i];
+        p[0] = x & 0xff;
+        p[1] = (x >> 8) & 0xff;
+        p[2] = (x >> 16) & 0xff;
+        p[3] = (x >> 24) & 0xff;
+    }
+}
+
+/* Stream 'count' numbers (0 = unlimited) as raw words. The buffer is large
+ * and 'out' is unbuffered so that each fwrite() goes straight to write().
+ */
+static int writebinary(RAND_MT *mt, FILE *out, unsigned long long count)
+{
+    static uint32_t buf[BINBUFLEN];
+    size_t n;
+
+    setvbuf(out, NULL, _IONBF, 0);
+    for (;;) {
+        n = BINBUFLEN;
+        if (count && count < n)
+            n = count;
+        mtrand_fill(mt, buf, n);
+        tolittleendian(buf, n);
+        if (fwrite(buf, sizeof buf[0], n, out) != n)
+            return -1;
+        if (count && (count -= n) == 0)
+            break;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    RAND_MT *mt;
+    unsigned long long i, count = NUM;
+    unsigned long seed = SEED;
+    int binary = 0, status = EXIT_SUCCESS;
+    const char *outname = NULL;
+    FILE *out = stdout;
+    char *end;
+
+    for (i = 1; i < (unsigned)argc; i++) {
+        if (!strcmp(argv[i], "--count") && i + 1 < (unsigned)argc) {
+            count = strtoull(argv[++i], &end, 0);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < (unsigned)argc) {
+            seed = strtoul(argv[++i], &end, 0);
+        } else if (!strcmp(argv[i], "--out") && i + 1 < (unsigned)argc) {
+            outname = argv[++i];
+            end = "";
+        } else if (!strcmp(argv[i], "--binary")) {
+            binary = 1;
+            end = "";
+        } else {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (*end) {
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     /* mt = mtrand_new(time(NULL)); */
-    mt = mtrand_new(10);
+    mt = mtrand_new(seed);
     if (!mt) {
         fputs("Could not initialise RNG. Aborting.", stderr);
         exit(EXIT_FAILURE);
     }
-    
-    printf("Generating %lu random numbers\n", NUM);
-    for (i = 0; i < NUM; i++)
-        printf("%lu\n", mtrand_get(mt));
-    printf("Done\n");
 
+    if (outname && !(out = fopen(outname, binary ? "wb" : "w"))) {
+        perror(outname);
+        exit(EXIT_FAILURE);
+    }
+
+    if (binary) {
+        if (writebinary(mt, out, count) != 0 && count != 0) {
+            perror("write");
+            status = EXIT_FAILURE;
+        }
+    } else {
+        fprintf(out, "Generating %llu random numbers\n", count);
+        for (i = 0; i < count; i++)
+            fprintf(out, "%lu\n", mtrand_get(mt));
+        fprintf(out, "Done\n");
+    }
+
+    if (out != stdout && fclose(out) != 0) {
+        perror(outname);
+        status = EXIT_FAILURE;
+    }
 
     mtrand_dispose(mt);
-    return EXIT_SUCCESS;
+    return status;
 }
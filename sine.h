@@ -0,0 +1,65 @@
+/*
+ * Sine and cosine (see sine.c)
+ *
+ * Build sine.c with -DSINE_NO_MAIN (and -pthread) to link it into another
+ * program.
+ */
+
+#ifndef Z_SINE
+#define Z_SINE
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* sin(x) and cos(x) for 'x' in degrees; max error 0.8 ulp */
+double mysin(double x);
+void mysincos(double x, double *s, double *c);
+
+/* The same for 'x' in radians */
+double mysin_rad(double x);
+void mysincos_rad(double x, double *s, double *c);
+
+/* sin() of 'n' angles at a time using the widest SIMD the CPU has. 'in'
+ * and 'out' may be the same array. A few ulps less accurate than the
+ * scalar functions.
+ */
+void mysin_batch(const double *in, double *out, size_t n);
+void mysinf_batch(const float *in, float *out, size_t n);
+void mysin_rad_batch(const double *in, double *out, size_t n);
+void mysincos_rad_batch(const double *in, double *s, double *c, size_t n);
+
+/* Table-driven sine for graphics and audio, where speed matters more than
+ * the last digits. The angle is a phase where 2^32 is one full turn.
+ */
+enum {
+    SINE_LINEAR,        /* Linear interpolation */
+    SINE_CUBIC          /* Cubic Hermite, slopes from the same table */
+};
+
+struct sinetable {
+    unsigned bits;      /* 2^bits entries per turn */
+    int interp;         /* SINE_LINEAR or SINE_CUBIC */
+    double maxerr;      /* Max error before rounding to the output type,
+                         * measured by sinetable_init()
+                         */
+    double *tab;        /* Private */
+    double fscale;      /* Private */
+    double slope;       /* Private */
+};
+
+/* 'bits' must be from 2 to 24. Returns 0, or -1 if it is out of range or
+ * the table cannot be allocated.
+ */
+int sinetable_init(struct sinetable *st, unsigned bits, int interp);
+void sinetable_free(struct sinetable *st);
+
+/* Phase of an angle in degrees or radians */
+uint32_t sine_phase(double degrees);
+uint32_t sine_phase_rad(double radians);
+
+/* sin() of 'phase' as a float, a Q15 or a Q31 number */
+float sinetable_f(const struct sinetable *st, uint32_t phase);
+int16_t sinetable_q15(const struct sinetable *st, uint32_t phase);
+int32_t sinetable_q31(const struct sinetable *st, uint32_t phase);
+
+#endif /* Z_SINE */